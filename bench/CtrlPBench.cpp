@@ -0,0 +1,253 @@
+#include "Document.h"
+#include "Grayscale.h"
+#include "SystemMemory.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPageSize>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPixmap>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <iostream>
+#include <sys/resource.h>
+
+// Headless throughput benchmark for the load, render, convert and upload
+// stages. Prints one JSON document to stdout so runs can be diffed.
+
+namespace {
+
+qint64 peakRssKB() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+void writeTextPages(const QString &path, int pages) {
+  QPdfWriter writer(path);
+  writer.setPageSize(QPageSize(QPageSize::A4));
+  writer.setResolution(72);
+
+  QPainter painter(&writer);
+  QFont font = painter.font();
+  font.setPointSize(10);
+  painter.setFont(font);
+
+  for (int page = 0; page < pages; page++) {
+    if (page > 0)
+      writer.newPage();
+
+    for (int line = 0; line < 60; line++)
+      painter.drawText(40, 50 + line * 12,
+                       QString("Page %1 line %2 The quick brown fox jumps "
+                               "over the lazy dog")
+                           .arg(page + 1)
+                           .arg(line + 1));
+  }
+}
+
+void writeHugePages(const QString &path, int pages) {
+  QPdfWriter writer(path);
+  writer.setPageSize(QPageSize(QPageSize::A0));
+  writer.setResolution(72);
+
+  QPainter painter(&writer);
+  QRect area = writer.pageLayout().paintRectPixels(72);
+
+  for (int page = 0; page < pages; page++) {
+    if (page > 0)
+      writer.newPage();
+
+    int bandHeight = area.height() / 16;
+    for (int band = 0; band < 16; band++)
+      painter.fillRect(QRect(area.left(), area.top() + band * bandHeight,
+                             area.width(), bandHeight),
+                       QColor::fromHsv((band * 22 + page * 40) % 360, 120,
+                                       230));
+  }
+}
+
+void writeVectorPages(const QString &path, int pages) {
+  QPdfWriter writer(path);
+  writer.setPageSize(QPageSize(QPageSize::A4));
+  writer.setResolution(72);
+
+  QPainter painter(&writer);
+  QRect area = writer.pageLayout().paintRectPixels(72);
+  QRandomGenerator random(42);
+
+  for (int page = 0; page < pages; page++) {
+    if (page > 0)
+      writer.newPage();
+
+    for (int i = 0; i < 20000; i++) {
+      painter.setPen(QColor::fromHsv(random.bounded(360), 200, 160));
+      painter.drawLine(area.left() + random.bounded(area.width()),
+                       area.top() + random.bounded(area.height()),
+                       area.left() + random.bounded(area.width()),
+                       area.top() + random.bounded(area.height()));
+    }
+  }
+}
+
+QJsonObject benchmarkLoad(const QString &path, Document::LoadMode mode) {
+  QJsonObject result;
+  result["mode"] = mode == Document::MemoryMap ? "mmap" : "read";
+
+  qint64 rssBefore = SystemMemory::residentKB();
+
+  Document document;
+  if (!document.load(path, mode)) {
+    result["error"] = document.errorString();
+    return result;
+  }
+
+  result["load_ms"] = document.loadTimeMs();
+  result["rss_delta_kb"] = SystemMemory::residentKB() - rssBefore;
+  return result;
+}
+
+QJsonObject benchmarkFile(const QString &path, const QList<double> &dpis,
+                          int maxPages, Document::LoadMode mode) {
+  QJsonObject result;
+  result["file"] = path;
+
+  QJsonArray loads;
+  loads.append(benchmarkLoad(path, Document::ReadFile));
+  loads.append(benchmarkLoad(path, Document::MemoryMap));
+  result["load_modes"] = loads;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  Document document;
+  if (!document.load(path, mode)) {
+    result["error"] = document.errorString();
+    return result;
+  }
+
+  double loadMs = timer.nsecsElapsed() / 1e6;
+  document.renderPage(0, 150.0);
+  double firstPageMs = timer.nsecsElapsed() / 1e6;
+
+  int pages = qMin(document.pageCount(), maxPages);
+
+  result["pages"] = document.pageCount();
+  result["load_ms"] = loadMs;
+  result["time_to_first_page_ms"] = firstPageMs;
+
+  QJsonArray runs;
+
+  for (double dpi : dpis) {
+    qint64 renderNs = 0;
+    qint64 grayscaleNs = 0;
+    qint64 pixmapNs = 0;
+    qint64 bytes = 0;
+
+    for (int i = 0; i < pages; i++) {
+      timer.restart();
+      QImage image = document.renderPage(i, dpi);
+      renderNs += timer.nsecsElapsed();
+
+      timer.restart();
+      QImage gray = Grayscale::fromColor(image);
+      grayscaleNs += timer.nsecsElapsed();
+
+      timer.restart();
+      QPixmap pixmap = QPixmap::fromImage(image);
+      pixmapNs += timer.nsecsElapsed();
+
+      bytes += image.sizeInBytes();
+    }
+
+    double renderMs = renderNs / 1e6;
+
+    QJsonObject run;
+    run["dpi"] = dpi;
+    run["pages"] = pages;
+    run["render_ms_per_page"] = pages > 0 ? renderMs / pages : 0.0;
+    run["pages_per_second"] = renderMs > 0 ? pages * 1000.0 / renderMs : 0.0;
+    run["grayscale_ms_per_page"] = pages > 0 ? grayscaleNs / 1e6 / pages : 0.0;
+    run["pixmap_ms_per_page"] = pages > 0 ? pixmapNs / 1e6 / pages : 0.0;
+    run["raster_mb_per_page"] =
+        pages > 0 ? bytes / (1024.0 * 1024.0) / pages : 0.0;
+    runs.append(run);
+  }
+
+  result["runs"] = runs;
+  result["peak_rss_kb"] = peakRssKB();
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  // QPixmap needs a GUI application, but the benchmark never shows a window
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+  QGuiApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("CtrlP render benchmark");
+  parser.addHelpOption();
+  parser.addOption({"dpi", "Comma separated DPIs to render at.", "list",
+                    "72,150,300"});
+  parser.addOption(
+      {"pages", "Maximum pages rendered per file and DPI.", "count", "20"});
+  parser.addOption(
+      {"mmap", "Memory-map the PDFs for the render runs instead of reading."});
+  parser.addOption({"corpus-pages", "Pages in each generated test PDF.",
+                    "count", "200"});
+  parser.addPositionalArgument(
+      "files", "PDFs to benchmark. A generated corpus is used when empty.");
+  parser.process(app);
+
+  QList<double> dpis;
+  for (const QString &value : parser.value("dpi").split(',')) {
+    bool ok;
+    double dpi = value.toDouble(&ok);
+    if (ok && dpi > 0)
+      dpis.append(dpi);
+  }
+
+  int maxPages = qMax(1, parser.value("pages").toInt());
+  Document::LoadMode mode =
+      parser.isSet("mmap") ? Document::MemoryMap : Document::ReadFile;
+  QStringList files = parser.positionalArguments();
+
+  QTemporaryDir corpusDir;
+  if (files.isEmpty()) {
+    if (!corpusDir.isValid()) {
+      std::cerr << "Failed to create corpus directory\n";
+      return 1;
+    }
+
+    int corpusPages = qMax(1, parser.value("corpus-pages").toInt());
+
+    files << corpusDir.filePath("many-pages.pdf")
+          << corpusDir.filePath("huge-pages.pdf")
+          << corpusDir.filePath("vector-heavy.pdf");
+
+    writeTextPages(files[0], corpusPages);
+    writeHugePages(files[1], 4);
+    writeVectorPages(files[2], qMin(corpusPages, 20));
+  }
+
+  QJsonArray results;
+  for (const QString &file : files)
+    results.append(benchmarkFile(file, dpis, maxPages, mode));
+
+  QJsonObject report;
+  report["files"] = results;
+  report["peak_rss_kb"] = peakRssKB();
+
+  std::cout << QJsonDocument(report).toJson().constData();
+
+  return 0;
+}
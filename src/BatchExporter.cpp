@@ -0,0 +1,126 @@
+#include "BatchExporter.h"
+#include "Imposition.h"
+#include "SheetRenderer.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QMutexLocker>
+#include <QThread>
+
+BatchExporter::BatchExporter(const Options &options)
+    : m_options(options), m_nextJob(0), m_pagesWritten(0) {}
+
+bool BatchExporter::run(const QStringList &files) {
+  m_files = files;
+  m_jobs.clear();
+  m_pages.clear();
+  m_pages.resize(m_files.size());
+  m_nextJob = 0;
+  m_pagesWritten = 0;
+  m_errors.clear();
+
+  if (!QDir().mkpath(m_options.outputDir)) {
+    m_errors.append("Cannot create " + m_options.outputDir);
+    return false;
+  }
+
+  // Sheet counts decide the job list up front so workers can interleave
+  // sheets of large documents instead of splitting work per file
+  for (int i = 0; i < m_files.size(); i++) {
+    Document document;
+    if (!document.load(m_files[i], m_options.loadMode)) {
+      m_errors.append(m_files[i] + ": " + document.errorString());
+      continue;
+    }
+
+    m_pages[i] = m_options.settings.rangePages(document.pageCount());
+
+    int sheets = Imposition::sheetCount(m_options.settings.pageLayout,
+                                        m_pages[i].size());
+
+    for (int sheet = 0; sheet < sheets; sheet++)
+      m_jobs.append({i, sheet});
+  }
+
+  int threads = m_options.threads > 0 ? m_options.threads
+                                      : qMax(1, QThread::idealThreadCount());
+  threads = qMin(threads, qMax(1, int(m_jobs.size())));
+
+  QList<QThread *> workers;
+  for (int i = 0; i < threads; i++) {
+    QThread *worker = QThread::create([this]() { workerLoop(); });
+    worker->start();
+    workers.append(worker);
+  }
+
+  for (QThread *worker : workers) {
+    worker->wait();
+    delete worker;
+  }
+
+  return m_errors.isEmpty();
+}
+
+void BatchExporter::workerLoop() {
+  Document document;
+  int loadedFile = -1;
+
+  Job job;
+  while (takeJob(&job)) {
+    if (job.fileIndex != loadedFile) {
+      if (!document.load(m_files[job.fileIndex], m_options.loadMode)) {
+        QMutexLocker locker(&m_mutex);
+        m_errors.append(m_files[job.fileIndex] + ": " +
+                        document.errorString());
+        loadedFile = -1;
+        continue;
+      }
+      loadedFile = job.fileIndex;
+    }
+
+    SheetLayout layout =
+        Imposition::sheet(document, m_options.settings,
+                          m_pages[job.fileIndex], job.sheetIndex);
+    QImage sheet = SheetRenderer::render(document, layout, m_options.dpi,
+                                         m_options.settings);
+
+    QString path = outputPath(job);
+    QImageWriter writer(path, m_options.format.toLatin1());
+
+    bool written = !sheet.isNull() && writer.write(sheet);
+
+    QMutexLocker locker(&m_mutex);
+    if (written)
+      m_pagesWritten++;
+    else
+      m_errors.append(path + ": " + (sheet.isNull() ? "render failed"
+                                                    : writer.errorString()));
+  }
+}
+
+bool BatchExporter::takeJob(Job *job) {
+  QMutexLocker locker(&m_mutex);
+  if (m_nextJob >= m_jobs.size())
+    return false;
+
+  *job = m_jobs[m_nextJob++];
+  return true;
+}
+
+QString BatchExporter::outputPath(const Job &job) const {
+  QString baseName = QFileInfo(m_files[job.fileIndex]).completeBaseName();
+
+  // 1-up files are numbered by page, imposed ones by sheet side
+  QString pattern = "%1-%2.%3";
+  int number = m_pages[job.fileIndex].value(job.sheetIndex) + 1;
+  if (m_options.settings.pageLayout != PrintSettings::OneUp) {
+    pattern = "%1-sheet%2.%3";
+    number = job.sheetIndex + 1;
+  }
+
+  return QDir(m_options.outputDir)
+      .filePath(QString(pattern)
+                    .arg(baseName)
+                    .arg(number, 4, 10, QChar('0'))
+                    .arg(m_options.format));
+}
@@ -0,0 +1,55 @@
+#ifndef BATCHEXPORTER_H_
+#define BATCHEXPORTER_H_
+
+#include "Document.h"
+#include "PrintSettings.h"
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Renders page ranges of many documents to image files without a window.
+// Every worker thread owns its own Document and takes one sheet at a time
+// through imposition, render and encoding, so all cores stay busy and only
+// one sheet per thread is alive at once.
+class BatchExporter {
+public:
+  struct Options {
+    QString outputDir;
+    QString format = "png";
+    double dpi = 150.0;
+    int threads = 0; // 0 means one per core
+    Document::LoadMode loadMode = Document::ReadFile;
+    PrintSettings settings;
+  };
+
+  explicit BatchExporter(const Options &options);
+
+  bool run(const QStringList &files);
+
+  int pagesWritten() const { return m_pagesWritten; }
+  QStringList errors() const { return m_errors; }
+
+private:
+  struct Job {
+    int fileIndex;
+    int sheetIndex;
+  };
+
+  void workerLoop();
+  bool takeJob(Job *job);
+  QString outputPath(const Job &job) const;
+
+  Options m_options;
+  QStringList m_files;
+  QVector<Job> m_jobs;
+  // Printed pages of every file, indexed like m_files
+  QVector<QVector<int>> m_pages;
+
+  QMutex m_mutex;
+  int m_nextJob;
+  int m_pagesWritten;
+  QStringList m_errors;
+};
+
+#endif // BATCHEXPORTER_H_
@@ -0,0 +1,235 @@
+#include "DiskCache.h"
+#include "Trace.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QVector>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Pixel data starts on a 32-byte boundary so scanlines stay aligned
+struct Header {
+  char magic[4];
+  quint32 version;
+  quint32 width;
+  quint32 height;
+  quint32 bytesPerLine;
+  quint32 format;
+  quint32 reserved[2];
+};
+
+static_assert(sizeof(Header) == 32, "Header must keep pixels aligned");
+
+const char Magic[4] = {'C', 'P', 'R', 'C'};
+const quint32 Version = 1;
+
+// Trimming stops below the cap so every store does not trigger a scan
+const double TrimRatio = 0.9;
+
+// Read from each end of the PDF for its hash. The head holds the header and
+// the tail the trailer with the document ID and cross-reference offsets.
+const qint64 HashedEndBytes = 64 * 1024;
+
+void unmapFile(void *info) { delete static_cast<QFile *>(info); }
+
+} // namespace
+
+DiskCache::DiskCache(const QString &directory, qint64 maxBytes)
+    : m_directory(directory), m_maxBytes(maxBytes), m_usedBytes(0),
+      m_hits(0), m_misses(0) {
+  QDir().mkpath(m_directory);
+
+  QDirIterator it(m_directory, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    it.next();
+    m_usedBytes += it.fileInfo().size();
+  }
+}
+
+QByteArray DiskCache::contentHash(const QString &filePath) {
+  TraceSpan span("hash");
+
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly))
+    return QByteArray();
+
+  qint64 size = file.size();
+  QDateTime modified = QFileInfo(file).lastModified();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(QByteArray::number(size));
+  hash.addData(QByteArray::number(modified.toMSecsSinceEpoch()));
+  hash.addData(file.read(HashedEndBytes));
+  if (size > HashedEndBytes) {
+    if (!file.seek(qMax(HashedEndBytes, size - HashedEndBytes)))
+      return QByteArray();
+    hash.addData(file.read(HashedEndBytes));
+  }
+
+  return hash.result().toHex();
+}
+
+QString DiskCache::filePath(const QByteArray &documentHash,
+                            const RasterKey &key) const {
+  return QString("%1/%2/%3-%4-%5.raw")
+      .arg(m_directory, QString::fromLatin1(documentHash))
+      .arg(key.pageNumber)
+      .arg(key.dpiKey)
+      .arg(key.colorMode ? 'c' : 'g');
+}
+
+QImage DiskCache::find(const QByteArray &documentHash, const RasterKey &key) {
+  if (documentHash.isEmpty())
+    return QImage();
+
+  TraceSpan span("diskRead", key.pageNumber, key.dpiKey / 100.0);
+
+  auto file = new QFile(filePath(documentHash, key));
+  uchar *data = nullptr;
+  if (file->open(QIODevice::ReadOnly) &&
+      file->size() >= qint64(sizeof(Header)))
+    data = file->map(0, file->size());
+
+  Header header;
+  bool valid = false;
+  if (data) {
+    std::memcpy(&header, data, sizeof(Header));
+    valid = std::memcmp(header.magic, Magic, sizeof(Magic)) == 0 &&
+            header.version == Version &&
+            header.format > QImage::Format_Invalid &&
+            header.format < QImage::NImageFormats &&
+            qint64(sizeof(Header)) +
+                    qint64(header.bytesPerLine) * header.height ==
+                file->size();
+  }
+
+  if (!valid) {
+    delete file;
+    QMutexLocker locker(&m_mutex);
+    m_misses++;
+    return QImage();
+  }
+
+  // Used files move to the back of the LRU order
+  file->setFileTime(QDateTime::currentDateTime(),
+                    QFileDevice::FileModificationTime);
+
+  {
+    QMutexLocker locker(&m_mutex);
+    m_hits++;
+  }
+
+  // The image reads from the mapping, which is released with the last copy.
+  // The mapping is read-only, so the image is given const data and copies
+  // it before anything writes to it.
+  const uchar *pixels = data + sizeof(Header);
+  return QImage(pixels, header.width, header.height, header.bytesPerLine,
+                QImage::Format(header.format), unmapFile, file);
+}
+
+void DiskCache::store(const QByteArray &documentHash, const RasterKey &key,
+                      const QImage &image) {
+  if (documentHash.isEmpty() || image.isNull())
+    return;
+
+  TraceSpan span("diskWrite", key.pageNumber, key.dpiKey / 100.0);
+
+  QString path = filePath(documentHash, key);
+  QFileInfo info(path);
+  QDir().mkpath(info.path());
+
+  // A raster stored again replaces its file, which is already counted
+  qint64 replaced = info.exists() ? info.size() : 0;
+
+  Header header = {};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.width = image.width();
+  header.height = image.height();
+  header.bytesPerLine = image.bytesPerLine();
+  header.format = image.format();
+
+  // Readers never see a partial file
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly))
+    return;
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+  file.write(reinterpret_cast<const char *>(image.constBits()),
+             image.sizeInBytes());
+  if (!file.commit())
+    return;
+
+  bool overBudget;
+  {
+    QMutexLocker locker(&m_mutex);
+    m_usedBytes += qint64(sizeof(Header)) + image.sizeInBytes() - replaced;
+    overBudget = m_usedBytes > m_maxBytes;
+  }
+
+  if (overBudget)
+    trim();
+}
+
+void DiskCache::trim() {
+  // One scan at a time; the others' stores are covered by it
+  if (!m_trimMutex.tryLock())
+    return;
+
+  struct Entry {
+    QString path;
+    qint64 size;
+    QDateTime used;
+  };
+
+  QVector<Entry> entries;
+  qint64 total = 0;
+
+  QDirIterator it(m_directory, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    it.next();
+    QFileInfo info = it.fileInfo();
+    entries.append({info.filePath(), info.size(), info.lastModified()});
+    total += info.size();
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.used < b.used; });
+
+  qint64 target = qint64(m_maxBytes * TrimRatio);
+  for (const Entry &entry : entries) {
+    if (total <= target)
+      break;
+    if (QFile::remove(entry.path))
+      total -= entry.size;
+  }
+
+  {
+    QMutexLocker locker(&m_mutex);
+    m_usedBytes = total;
+  }
+
+  m_trimMutex.unlock();
+}
+
+qint64 DiskCache::usedBytes() const {
+  QMutexLocker locker(&m_mutex);
+  return m_usedBytes;
+}
+
+quint64 DiskCache::hits() const {
+  QMutexLocker locker(&m_mutex);
+  return m_hits;
+}
+
+quint64 DiskCache::misses() const {
+  QMutexLocker locker(&m_mutex);
+  return m_misses;
+}
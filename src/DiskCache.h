@@ -0,0 +1,49 @@
+#ifndef DISKCACHE_H_
+#define DISKCACHE_H_
+
+#include "RasterCache.h"
+#include <QByteArray>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+// Rendered pages kept on disk across sessions, one file per raster under a
+// directory named after the content hash of the PDF. Files hold a small
+// header and the raw scanlines, so reading one back is a memory map and the
+// returned image points straight into the mapping. The total size is capped
+// and the least recently used files go first. All methods are thread-safe.
+class DiskCache {
+public:
+  DiskCache(const QString &directory, qint64 maxBytes);
+
+  // Identifies the document in every key: a hash of the file's size,
+  // modification time and first and last bytes. Reading those is cheap even
+  // for large files on network mounts, and any rewrite changes the time.
+  // Empty when the file cannot be read.
+  static QByteArray contentHash(const QString &filePath);
+
+  QImage find(const QByteArray &documentHash, const RasterKey &key);
+  void store(const QByteArray &documentHash, const RasterKey &key,
+             const QImage &image);
+
+  QString directory() const { return m_directory; }
+  qint64 maxBytes() const { return m_maxBytes; }
+  qint64 usedBytes() const;
+  quint64 hits() const;
+  quint64 misses() const;
+
+private:
+  QString filePath(const QByteArray &documentHash, const RasterKey &key) const;
+  void trim();
+
+  QString m_directory;
+  qint64 m_maxBytes;
+
+  QMutex m_trimMutex;
+  mutable QMutex m_mutex;
+  qint64 m_usedBytes;
+  quint64 m_hits;
+  quint64 m_misses;
+};
+
+#endif // DISKCACHE_H_
@@ -1,43 +1,145 @@
 #include "Document.h"
+#include "Trace.h"
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
 #include <QImage>
+#include <QVariant>
 #include <QtMath>
 #include <poppler/qt6/poppler-qt6.h>
 
-Document::Document() : m_document(nullptr), m_errorString("") {}
+Document::Document()
+    : m_document(nullptr), m_maxPageWidth(0.0), m_errorString(""),
+      m_loadMode(ReadFile), m_loadTimeMs(0.0), m_lastRenderMs(0.0) {}
 
 Document::~Document() {}
 
-bool Document::load(const QString &filePath) {
+Document::Document(Document &&other) = default;
+
+Document &Document::operator=(Document &&other) {
+  if (this == &other)
+    return *this;
+
+  // The previous document has to go before the mapping it may be reading
+  m_document.reset();
+  m_mappedBuffer.reset();
+  m_mappedFile.reset();
+
+  m_mappedFile = std::move(other.m_mappedFile);
+  m_mappedBuffer = std::move(other.m_mappedBuffer);
+  m_document = std::move(other.m_document);
+  m_pageGeometry = std::move(other.m_pageGeometry);
+  m_maxPageWidth = other.m_maxPageWidth;
+  m_errorString = std::move(other.m_errorString);
+  m_filePath = std::move(other.m_filePath);
+  m_loadMode = other.m_loadMode;
+  m_loadTimeMs = other.m_loadTimeMs;
+  m_lastRenderMs = other.m_lastRenderMs;
+  return *this;
+}
+
+bool Document::load(const QString &filePath, LoadMode mode) {
+  TraceSpan span("load");
+  QElapsedTimer timer;
+  timer.start();
+
+  // The previous document has to go before the mapping it may be reading
+  m_document.reset();
+  m_mappedBuffer.reset();
+  m_mappedFile.reset();
+  m_pageGeometry.clear();
 
   QFileInfo fileInfo(filePath);
   if (!fileInfo.exists() || !fileInfo.isFile()) {
     m_errorString = "File does not exist";
-    m_document.reset();
     return false;
   }
 
-  auto doc = Poppler::Document::load(filePath);
+  std::unique_ptr<Poppler::Document> doc;
+
+  if (mode == MemoryMap) {
+    auto file = std::make_unique<QFile>(filePath);
+    uchar *data = nullptr;
+    if (file->open(QIODevice::ReadOnly))
+      data = file->map(0, file->size());
+
+    if (!data) {
+      m_errorString = "Failed to map file";
+      return false;
+    }
+
+    // QBuffer only ever reads the raw bytes through constData(), so Poppler
+    // streams straight out of the mapping without a heap copy
+    auto buffer = std::make_unique<QBuffer>();
+    buffer->setData(QByteArray::fromRawData(
+        reinterpret_cast<const char *>(data), file->size()));
+    buffer->open(QIODevice::ReadOnly);
+
+    doc = Poppler::Document::load(buffer.get());
+    if (doc) {
+      m_mappedFile = std::move(file);
+      m_mappedBuffer = std::move(buffer);
+    }
+  } else {
+    doc = Poppler::Document::load(filePath);
+  }
 
   if (!doc) {
     m_errorString = "Failed to load PDF";
-    m_document.reset();
     return false;
   }
 
   m_document = std::move(doc);
   m_filePath = filePath;
+  m_loadMode = mode;
   m_errorString.clear();
 
+  buildPageGeometry();
+
+  m_loadTimeMs = timer.nsecsElapsed() / 1e6;
+
   return true;
 }
 
+Document::LoadMode Document::loadMode() const { return m_loadMode; }
+
+double Document::loadTimeMs() const { return m_loadTimeMs; }
+
+QString Document::filePath() const { return m_filePath; }
+
+void Document::buildPageGeometry() {
+  int count = m_document->numPages();
+
+  m_pageGeometry.clear();
+  m_pageGeometry.reserve(count);
+  m_maxPageWidth = 0.0;
+
+  double offset = 0.0;
+
+  for (int i = 0; i < count; i++) {
+    PageGeometry geometry;
+
+    auto page = m_document->page(i);
+    geometry.sizePoints = page ? page->pageSizeF() : QSizeF(0, 0);
+    geometry.sizeMM = QSizeF(pointsToMM(geometry.sizePoints.width()),
+                             pointsToMM(geometry.sizePoints.height()));
+    geometry.paperSize = detectPaperSize(geometry.sizeMM);
+    geometry.offsetPoints = offset;
+
+    offset += geometry.sizePoints.height();
+    m_maxPageWidth = qMax(m_maxPageWidth, geometry.sizePoints.width());
+    m_pageGeometry.append(geometry);
+  }
+}
+
 bool Document::isLoaded() const { return m_document != nullptr; }
 
 int Document::pageCount() const {
   if (!isLoaded())
     return 0;
-  return m_document->numPages();
+  return m_pageGeometry.size();
 }
 
 QSizeF Document::pageSize(int pageNumber) const {
@@ -46,11 +148,7 @@ QSizeF Document::pageSize(int pageNumber) const {
   if (pageNumber < 0 || pageNumber >= pageCount())
     return QSizeF(0, 0);
 
-  auto page = m_document->page(pageNumber);
-  if (!page)
-    return QSizeF(0, 0);
-
-  return page->pageSizeF();
+  return m_pageGeometry[pageNumber].sizePoints;
 }
 
 QString Document::title() const {
@@ -65,12 +163,39 @@ Poppler::Document *Document::popplerDocument() const {
   return m_document.get();
 }
 
+double Document::maxPageWidth() const { return m_maxPageWidth; }
+
 double Document::pointsToMM(double points) { return points * 25.4 / 72; }
 
 QSizeF Document::pageSizeMM(int pageNumber) const {
-  QSizeF sizePoints = pageSize(pageNumber);
-  return QSizeF(pointsToMM(sizePoints.width()),
-                pointsToMM(sizePoints.height()));
+  if (!isLoaded())
+    return QSizeF(0, 0);
+  if (pageNumber < 0 || pageNumber >= pageCount())
+    return QSizeF(0, 0);
+
+  return m_pageGeometry[pageNumber].sizeMM;
+}
+
+QString Document::paperSize(int pageNumber) const {
+  if (!isLoaded())
+    return QString();
+  if (pageNumber < 0 || pageNumber >= pageCount())
+    return QString();
+
+  return m_pageGeometry[pageNumber].paperSize;
+}
+
+double Document::pageOffset(int pageNumber) const {
+  if (!isLoaded() || m_pageGeometry.isEmpty())
+    return 0.0;
+  if (pageNumber <= 0)
+    return 0.0;
+  if (pageNumber >= pageCount()) {
+    const PageGeometry &last = m_pageGeometry.last();
+    return last.offsetPoints + last.sizePoints.height();
+  }
+
+  return m_pageGeometry[pageNumber].offsetPoints;
 }
 
 QString Document::detectPaperSize(const QSizeF &sizeMM) {
@@ -103,6 +228,8 @@ QString Document::detectPaperSize(const QSizeF &sizeMM) {
 }
 
 QImage Document::renderPage(int pageNumber, double dpi) const {
+  TraceSpan span("render", pageNumber, dpi);
+
   if (!isLoaded())
     return QImage();
 
@@ -113,6 +240,87 @@ QImage Document::renderPage(int pageNumber, double dpi) const {
   if (!page)
     return QImage();
 
+  QElapsedTimer timer;
+  timer.start();
+
   QImage image = page->renderToImage(dpi, dpi);
+
+  m_lastRenderMs = timer.nsecsElapsed() / 1e6;
   return image;
 }
+
+QImage Document::renderTile(int pageNumber, double dpi, const QRect &tile,
+                            const QAtomicInt *abort) const {
+  TraceSpan span("renderTile", pageNumber, dpi);
+
+  if (!isLoaded())
+    return QImage();
+
+  if (pageNumber < 0 || pageNumber >= pageCount())
+    return QImage();
+
+  auto page = m_document->page(pageNumber);
+  if (!page)
+    return QImage();
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Poppler only rasterizes the requested sub-rectangle, given in pixels at
+  // the target resolution, and polls the abort flag while it does
+  auto aborted = [](const QVariant &flag) {
+    return static_cast<const QAtomicInt *>(flag.value<void *>())
+               ->loadAcquire() != 0;
+  };
+  QImage image =
+      abort ? page->renderToImage(dpi, dpi, tile.x(), tile.y(), tile.width(),
+                                  tile.height(), Poppler::Page::Rotate0,
+                                  nullptr, nullptr, aborted,
+                                  QVariant::fromValue(
+                                      const_cast<void *>(
+                                          static_cast<const void *>(abort))))
+            : page->renderToImage(dpi, dpi, tile.x(), tile.y(), tile.width(),
+                                  tile.height());
+  if (abort && abort->loadAcquire())
+    image = QImage();
+
+  m_lastRenderMs = timer.nsecsElapsed() / 1e6;
+  return image;
+}
+
+double Document::lastRenderMs() const { return m_lastRenderMs; }
+
+QByteArray Document::pageSignature(int pageNumber) const {
+  if (!isLoaded() || pageNumber < 0 || pageNumber >= pageCount())
+    return QByteArray();
+
+  auto page = m_document->page(pageNumber);
+  if (!page)
+    return QByteArray();
+
+  TraceSpan span("signature", pageNumber);
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  QSizeF size = page->pageSizeF();
+  hash.addData(QByteArray::number(size.width()) + 'x' +
+               QByteArray::number(size.height()));
+  hash.addData(QByteArray::number(int(page->orientation())));
+
+  // Text catches edits too small to change a coarse render, the render
+  // catches graphics
+  for (const auto &box : page->textList()) {
+    QRectF rect = box->boundingBox();
+    hash.addData(box->text().toUtf8());
+    hash.addData(QByteArray::number(rect.x()) + ',' +
+                 QByteArray::number(rect.y()));
+  }
+
+  QImage image = page->renderToImage(24.0, 24.0);
+  if (!image.isNull())
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(
+                                    image.constBits()),
+                                image.sizeInBytes()));
+
+  return hash.result();
+}
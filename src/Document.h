@@ -1,21 +1,50 @@
 #ifndef DOCUMENT_H_
 #define DOCUMENT_H_
 
+#include <QAtomicInt>
+#include <QByteArray>
 #include <QImage>
+#include <QRect>
 #include <QSizeF>
 #include <QString>
+#include <QVector>
 #include <memory>
 
 namespace Poppler {
 class Document;
 };
 
+class QBuffer;
+class QFile;
+
+// Per-page geometry, built once at load so layout and status queries never
+// touch Poppler
+struct PageGeometry {
+  QSizeF sizePoints;
+  QSizeF sizeMM;
+  QString paperSize;
+  double offsetPoints; // Sum of the heights of all preceding pages
+};
+
 class Document {
 public:
+  // MemoryMap hands Poppler the mapped file instead of letting it read the
+  // file into memory, so pages are faulted in only when they are touched.
+  // Only for files nothing rewrites while they are open: a read past the
+  // end of a truncated file raises SIGBUS.
+  enum LoadMode { ReadFile, MemoryMap };
+
   Document();
   ~Document();
+  Document(Document &&other);
+  // Replaces a loaded document with one loaded elsewhere, so a reload can
+  // parse the new file before giving up the old one
+  Document &operator=(Document &&other);
 
-  bool load(const QString &filePath);
+  bool load(const QString &filePath, LoadMode mode = ReadFile);
+  LoadMode loadMode() const;
+  double loadTimeMs() const;
+  QString filePath() const;
   bool isLoaded() const;
   int pageCount() const;
   QSizeF pageSize(int pageNumber) const;
@@ -24,13 +53,36 @@ public:
   Poppler::Document *popplerDocument() const;
   static double pointsToMM(double points);
   QSizeF pageSizeMM(int pageNumber) const;
+  QString paperSize(int pageNumber) const;
+  double pageOffset(int pageNumber) const;
+  double maxPageWidth() const;
   static QString detectPaperSize(const QSizeF &sizeMM);
   QImage renderPage(int pageNumber, double dpi = 150.0) const;
+  // A set abort flag stops the render part way and yields a null image
+  QImage renderTile(int pageNumber, double dpi, const QRect &tile,
+                    const QAtomicInt *abort = nullptr) const;
+  // Wall time of the most recent renderPage() or renderTile() call
+  double lastRenderMs() const;
+
+  // Fingerprint of what a page shows: its size, its words with their boxes
+  // and a coarse render. Equal signatures across reloads mean the page's
+  // rasters are still valid.
+  QByteArray pageSignature(int pageNumber) const;
 
 private:
+  void buildPageGeometry();
+
+  // Declared before m_document so the mapping outlives the Poppler document
+  std::unique_ptr<QFile> m_mappedFile;
+  std::unique_ptr<QBuffer> m_mappedBuffer;
   std::unique_ptr<Poppler::Document> m_document;
+  QVector<PageGeometry> m_pageGeometry;
+  double m_maxPageWidth;
   QString m_errorString;
   QString m_filePath;
+  LoadMode m_loadMode;
+  double m_loadTimeMs;
+  mutable double m_lastRenderMs;
 };
 
 #endif // DOCUMENT_H_
@@ -0,0 +1,185 @@
+#include "DocumentWatcher.h"
+#include "DiskCache.h"
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QMetaObject>
+#include <QThread>
+#include <QTimer>
+
+DocumentWatcher::DocumentWatcher(QObject *parent)
+    : QObject(parent), m_reporting(false), m_changedPages(0),
+      m_scanThread(nullptr), m_cancelScan(0), m_scanGeneration(0) {
+  m_watcher = new QFileSystemWatcher(this);
+  connect(m_watcher, &QFileSystemWatcher::fileChanged, this,
+          &DocumentWatcher::onFileChanged);
+
+  m_settleTimer = new QTimer(this);
+  m_settleTimer->setSingleShot(true);
+  m_settleTimer->setInterval(300);
+  connect(m_settleTimer, &QTimer::timeout, this, &DocumentWatcher::onSettled);
+}
+
+DocumentWatcher::~DocumentWatcher() { stopScan(); }
+
+void DocumentWatcher::watch(const QString &filePath,
+                            const QByteArray &fingerprint) {
+  if (!m_watcher->files().isEmpty())
+    m_watcher->removePaths(m_watcher->files());
+
+  m_filePath = filePath;
+  m_signatures.clear();
+  m_watcher->addPath(filePath);
+
+  startScan(false, fingerprint, QList<int>());
+}
+
+void DocumentWatcher::rescan(const QByteArray &fingerprint,
+                             const QList<int> &firstPages) {
+  startScan(true, fingerprint, firstPages);
+}
+
+bool DocumentWatcher::isPending(int page) const {
+  return m_reporting && (page >= m_compared.size() || !m_compared[page]);
+}
+
+void DocumentWatcher::onFileChanged() {
+  // Every write restarts the wait
+  m_settleTimer->start();
+}
+
+void DocumentWatcher::onSettled() {
+  // Tools that replace the file leave a gap where it does not exist, and
+  // the watcher drops a path once its file is gone
+  if (!QFileInfo::exists(m_filePath)) {
+    m_settleTimer->start();
+    return;
+  }
+
+  if (!m_watcher->files().contains(m_filePath))
+    m_watcher->addPath(m_filePath);
+
+  emit fileChanged();
+}
+
+void DocumentWatcher::startScan(bool report, const QByteArray &fingerprint,
+                                const QList<int> &firstPages) {
+  stopScan();
+
+  quint64 generation = ++m_scanGeneration;
+  QString filePath = m_filePath;
+  m_reporting = report;
+  m_compared.clear();
+  m_changedPages = 0;
+
+  m_scanThread = QThread::create([this, generation, filePath, fingerprint,
+                                  firstPages]() {
+    // The path was watched before this, so a file that still matches the
+    // window's copy here cannot change unnoticed. One that does not was
+    // rewritten after the window loaded it, maybe before the watch began.
+    if (DiskCache::contentHash(filePath) != fingerprint) {
+      QMetaObject::invokeMethod(
+          this,
+          [this, generation]() {
+            if (generation == m_scanGeneration)
+              m_settleTimer->start();
+          },
+          Qt::QueuedConnection);
+      return;
+    }
+
+    Document document;
+    if (!document.load(filePath, Document::ReadFile))
+      return;
+
+    int pageCount = document.pageCount();
+    QVector<bool> queued(pageCount, false);
+    QVector<int> order;
+    order.reserve(pageCount);
+    for (int page : firstPages) {
+      if (page >= 0 && page < pageCount && !queued[page]) {
+        queued[page] = true;
+        order.append(page);
+      }
+    }
+    int firstCount = order.size();
+    for (int page = 0; page < pageCount; page++) {
+      if (!queued[page])
+        order.append(page);
+    }
+
+    QVector<int> pages;
+    QVector<QByteArray> signatures;
+    auto post = [&](bool done) {
+      QMetaObject::invokeMethod(
+          this,
+          [this, generation, pages, signatures, pageCount, done]() {
+            onScanned(generation, pages, signatures, pageCount, done);
+          },
+          Qt::QueuedConnection);
+      pages.clear();
+      signatures.clear();
+    };
+
+    for (int i = 0; i < order.size(); i++) {
+      if (m_cancelScan.loadAcquire())
+        return;
+      pages.append(order[i]);
+      signatures.append(document.pageSignature(order[i]));
+
+      // The first pages go out on their own, since they are on screen
+      if (i + 1 < order.size() &&
+          (i + 1 == firstCount || pages.size() == BatchPages))
+        post(false);
+    }
+    post(true);
+  });
+  m_scanThread->start(QThread::LowPriority);
+}
+
+void DocumentWatcher::stopScan() {
+  if (!m_scanThread)
+    return;
+
+  m_cancelScan.storeRelease(1);
+  m_scanThread->wait();
+  delete m_scanThread;
+  m_scanThread = nullptr;
+  m_cancelScan.storeRelease(0);
+}
+
+void DocumentWatcher::onScanned(quint64 generation, const QVector<int> &pages,
+                                const QVector<QByteArray> &signatures,
+                                int pageCount, bool done) {
+  if (generation != m_scanGeneration)
+    return;
+
+  // Pages compare by position; anything past the old end, or not reached
+  // by a scan that never finished, has no signature and counts as changed.
+  // Each page's signature is replaced once compared, so a scan cut short by
+  // the next rewrite leaves the baseline matching what is shown.
+  m_signatures.resize(pageCount);
+  if (m_compared.size() != pageCount)
+    m_compared.fill(false, pageCount);
+
+  QList<int> changed;
+  for (int i = 0; i < pages.size(); i++) {
+    int page = pages[i];
+    if (m_signatures[page].isEmpty() || signatures[i] != m_signatures[page])
+      changed.append(page);
+    m_signatures[page] = signatures[i];
+    m_compared[page] = true;
+  }
+
+  if (!m_reporting)
+    return;
+
+  m_changedPages += changed.size();
+  if (!changed.isEmpty())
+    emit pagesChanged(changed);
+
+  if (done) {
+    m_reporting = false;
+    m_compared.clear();
+    emit rescanned(m_changedPages, pageCount);
+  }
+}
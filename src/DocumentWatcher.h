@@ -0,0 +1,75 @@
+#ifndef DOCUMENTWATCHER_H_
+#define DOCUMENTWATCHER_H_
+
+#include "Document.h"
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QFileSystemWatcher;
+class QThread;
+class QTimer;
+
+// Watches the open PDF for rewrites and tells which pages changed. Changes
+// are reported once the file has been quiet for a moment, since build tools
+// write it in several steps or replace it outright. Page signatures are
+// computed on a background thread with its own Document after every load
+// and compared with the previous set, the pages on screen first so they are
+// fixed up at once and the rest in batches. Watched files are always read
+// rather than mapped, since the rewrite truncates them.
+class DocumentWatcher : public QObject {
+  Q_OBJECT
+
+public:
+  explicit DocumentWatcher(QObject *parent = nullptr);
+  ~DocumentWatcher();
+
+  // Starts watching and takes the baseline signatures. The fingerprint is
+  // DiskCache::contentHash() of the file as it was loaded; if the file no
+  // longer matches it, the load already missed a rewrite and a change is
+  // reported instead.
+  void watch(const QString &filePath, const QByteArray &fingerprint);
+  // Takes new signatures after a reload and reports the difference, the
+  // given pages first
+  void rescan(const QByteArray &fingerprint, const QList<int> &firstPages);
+  // True for pages of a reloaded file not compared yet, whose cached
+  // rasters may still show the old file
+  bool isPending(int page) const;
+
+signals:
+  void fileChanged();
+  // Emitted per batch with the changed pages in it
+  void pagesChanged(const QList<int> &pages);
+  void rescanned(int changedPages, int pageCount);
+
+private:
+  void onFileChanged();
+  void onSettled();
+  void startScan(bool report, const QByteArray &fingerprint,
+                 const QList<int> &firstPages);
+  void stopScan();
+  void onScanned(quint64 generation, const QVector<int> &pages,
+                 const QVector<QByteArray> &signatures, int pageCount,
+                 bool done);
+
+  // Pages per report after the first ones
+  static const int BatchPages = 32;
+
+  QFileSystemWatcher *m_watcher;
+  QTimer *m_settleTimer;
+  QString m_filePath;
+
+  // Signatures of the pages as shown, updated as each batch is compared
+  QVector<QByteArray> m_signatures;
+  bool m_reporting;
+  QVector<bool> m_compared;
+  int m_changedPages;
+  QThread *m_scanThread;
+  QAtomicInt m_cancelScan;
+  quint64 m_scanGeneration;
+};
+
+#endif // DOCUMENTWATCHER_H_
@@ -0,0 +1,73 @@
+#include "Grayscale.h"
+#include <QColor>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// qGray(): (11 r + 16 g + 5 b) / 32, which stays within 16 bits
+void convertRow(const quint32 *pixels, uchar *gray, int count) {
+  int i = 0;
+
+#if defined(__SSE2__)
+  // Eight pixels per step: the channels of two registers are masked out of
+  // their 32-bit lanes and packed into 16-bit lanes, weighted, summed and
+  // packed once more into bytes
+  const __m128i low = _mm_set1_epi32(0xff);
+  const __m128i redWeight = _mm_set1_epi16(11);
+  const __m128i greenWeight = _mm_set1_epi16(16);
+  const __m128i blueWeight = _mm_set1_epi16(5);
+
+  auto channel = [&](__m128i first, __m128i second, int shift) {
+    return _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(first, shift), low),
+                           _mm_and_si128(_mm_srli_epi32(second, shift), low));
+  };
+
+  for (; i + 8 <= count; i += 8) {
+    __m128i first =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+    __m128i second =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i + 4));
+
+    __m128i sum = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(channel(first, second, 16), redWeight),
+                      _mm_mullo_epi16(channel(first, second, 8), greenWeight)),
+        _mm_mullo_epi16(channel(first, second, 0), blueWeight));
+
+    __m128i shifted = _mm_srli_epi16(sum, 5);
+    __m128i bytes = _mm_packus_epi16(shifted, shifted);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(gray + i), bytes);
+  }
+#endif
+
+  for (; i < count; i++)
+    gray[i] = uchar(qGray(pixels[i]));
+}
+
+} // namespace
+
+namespace Grayscale {
+
+QImage fromColor(const QImage &image) {
+  if (image.format() == QImage::Format_Grayscale8)
+    return image;
+
+  if (image.format() != QImage::Format_RGB32 &&
+      image.format() != QImage::Format_ARGB32 &&
+      image.format() != QImage::Format_ARGB32_Premultiplied)
+    return image.convertToFormat(QImage::Format_Grayscale8);
+
+  QImage gray(image.size(), QImage::Format_Grayscale8);
+  if (gray.isNull())
+    return gray;
+
+  for (int y = 0; y < image.height(); y++)
+    convertRow(reinterpret_cast<const quint32 *>(image.constScanLine(y)),
+               gray.scanLine(y), image.width());
+
+  return gray;
+}
+
+} // namespace Grayscale
@@ -0,0 +1,17 @@
+#ifndef GRAYSCALE_H_
+#define GRAYSCALE_H_
+
+#include <QImage>
+
+// Grayscale previews derived from colour rasters. Every grayscale raster in
+// the viewer and in printed output goes through here, so one converted from
+// a cached colour raster matches one rendered in grayscale pixel for pixel.
+namespace Grayscale {
+
+// Format_Grayscale8 copy of the image using qGray()'s weights. 32-bit
+// rasters take a vectorized path; anything else falls back to Qt.
+QImage fromColor(const QImage &image);
+
+} // namespace Grayscale
+
+#endif // GRAYSCALE_H_
@@ -0,0 +1,148 @@
+#include "Imposition.h"
+#include "Document.h"
+
+namespace {
+
+QSizeF landscape(const QSizeF &size) {
+  return QSizeF(qMax(size.width(), size.height()),
+                qMin(size.width(), size.height()));
+}
+
+QSizeF portrait(const QSizeF &size) {
+  return QSizeF(qMin(size.width(), size.height()),
+                qMax(size.width(), size.height()));
+}
+
+QRectF fitInto(const QRectF &cell, const QSizeF &pagePoints) {
+  if (pagePoints.isEmpty())
+    return cell;
+
+  double scale = qMin(cell.width() / pagePoints.width(),
+                      cell.height() / pagePoints.height());
+  QSizeF size = pagePoints * scale;
+
+  return QRectF(cell.left() + (cell.width() - size.width()) / 2,
+                cell.top() + (cell.height() - size.height()) / 2,
+                size.width(), size.height());
+}
+
+} // namespace
+
+int Imposition::pagesPerSide(PrintSettings::PageLayout layout) {
+  switch (layout) {
+  case PrintSettings::TwoUp:
+  case PrintSettings::Booklet:
+    return 2;
+  case PrintSettings::FourUp:
+    return 4;
+  default:
+    return 1;
+  }
+}
+
+int Imposition::sheetCount(PrintSettings::PageLayout layout, int pageCount) {
+  if (pageCount <= 0)
+    return 0;
+
+  // Four pages per folded sheet, two on each side
+  if (layout == PrintSettings::Booklet)
+    return (pageCount + 3) / 4 * 2;
+
+  int perSide = pagesPerSide(layout);
+  return (pageCount + perSide - 1) / perSide;
+}
+
+SheetLayout Imposition::sheet(const Document &document,
+                              const PrintSettings &settings,
+                              const QVector<int> &pages, int sheetIndex) {
+  SheetLayout sheet;
+  if (sheetIndex < 0 || pages.isEmpty())
+    return sheet;
+
+  if (settings.pageLayout == PrintSettings::OneUp) {
+    int page = pages.value(sheetIndex, pages.last());
+    sheet.paperPoints = document.pageSize(page);
+    sheet.placements.append(
+        {page, settings.targetRect(sheet.paperPoints, sheet.paperPoints),
+         settings.marginRect(sheet.paperPoints)});
+    return sheet;
+  }
+
+  int pageCount = pages.size();
+  QSizeF firstPaper = document.pageSize(pages.first());
+
+  // Offsets into pages of the cells in reading order; out of range means
+  // blank
+  QVector<int> order;
+  int columns = 2;
+  int rows = 1;
+
+  switch (settings.pageLayout) {
+  case PrintSettings::TwoUp:
+    sheet.paperPoints = landscape(firstPaper);
+    for (int i = 0; i < 2; i++)
+      order.append(sheetIndex * 2 + i);
+    break;
+
+  case PrintSettings::FourUp:
+    sheet.paperPoints = portrait(firstPaper);
+    rows = 2;
+    for (int i = 0; i < 4; i++)
+      order.append(sheetIndex * 4 + i);
+    break;
+
+  case PrintSettings::Booklet: {
+    // Outer pages go on the outside of the fold: with four pages the front
+    // carries 4|1 and the back 2|3
+    sheet.paperPoints = landscape(firstPaper);
+    int padded = sheetCount(PrintSettings::Booklet, pageCount) * 2;
+    int outer = padded - 1 - sheetIndex;
+
+    if (sheetIndex % 2 == 0)
+      order << outer << sheetIndex;
+    else
+      order << sheetIndex << outer;
+    break;
+  }
+
+  default:
+    break;
+  }
+
+  QRectF area = settings.marginRect(sheet.paperPoints);
+  double cellWidth = area.width() / columns;
+  double cellHeight = area.height() / rows;
+
+  for (int i = 0; i < order.size(); i++) {
+    if (order[i] < 0 || order[i] >= pageCount)
+      continue;
+
+    int page = pages[order[i]];
+    QRectF cell(area.left() + (i % columns) * cellWidth,
+                area.top() + (i / columns) * cellHeight, cellWidth,
+                cellHeight);
+
+    sheet.placements.append(
+        {page, fitInto(cell, document.pageSize(page)), cell});
+  }
+
+  return sheet;
+}
+
+QVector<SheetLayout> Imposition::sheets(const Document &document,
+                                        const PrintSettings &settings) {
+  QVector<SheetLayout> result;
+
+  int pageCount = document.pageCount();
+  if (pageCount == 0)
+    return result;
+
+  QVector<int> pages = settings.rangePages(pageCount);
+  int count = sheetCount(settings.pageLayout, pages.size());
+
+  result.reserve(count);
+  for (int i = 0; i < count; i++)
+    result.append(sheet(document, settings, pages, i));
+
+  return result;
+}
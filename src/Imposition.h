@@ -0,0 +1,46 @@
+#ifndef IMPOSITION_H_
+#define IMPOSITION_H_
+
+#include "PrintSettings.h"
+#include <QRectF>
+#include <QSizeF>
+#include <QVector>
+
+class Document;
+
+// A page placed on a sheet. rect is where the whole page lands and clip is
+// the part of the sheet it may cover, both in sheet points.
+struct PagePlacement {
+  int pageNumber;
+  QRectF rect;
+  QRectF clip;
+};
+
+// One printed side and the pages on it
+struct SheetLayout {
+  QSizeF paperPoints;
+  QVector<PagePlacement> placements;
+};
+
+// Places the printed pages on sheets according to the page
+// layout. 1-up keeps every page on its own paper size and scale mode; the
+// other layouts split the printable area of the first page's paper into
+// cells and fit one page into each. Booklets are ordered for saddle
+// stitching: the pages are padded to a multiple of four and every pair of
+// sides makes one folded sheet.
+class Imposition {
+public:
+  static int pagesPerSide(PrintSettings::PageLayout layout);
+  static int sheetCount(PrintSettings::PageLayout layout, int pageCount);
+
+  // pages are the printed pages in order, as from rangePages()
+  static SheetLayout sheet(const Document &document,
+                           const PrintSettings &settings,
+                           const QVector<int> &pages, int sheetIndex);
+
+  // Every sheet of the settings' print range
+  static QVector<SheetLayout> sheets(const Document &document,
+                                     const PrintSettings &settings);
+};
+
+#endif // IMPOSITION_H_
@@ -0,0 +1,410 @@
+#include "InkCoverage.h"
+#include "Trace.h"
+#include <QColor>
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+#include <memory>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Enough to tell paper from ink; coverage is an estimate either way
+const double ScanDpi = 50.0;
+
+// A pixel is ink when its darkest channel is below this
+const int InkThreshold = 232;
+
+// A pixel is colour when its channels spread further apart than this, which
+// JPEG noise in gray scans stays under
+const int ChromaThreshold = 24;
+
+// Pages with fewer inked pixels are blank. At ScanDpi this is about a dozen
+// pixels of an A4 page: less than a lone page number, more than dust on a
+// scanned sheet.
+const double BlankInkedFraction = 0.00005;
+
+// A few colour pixels make a colour page, since that is how colour printers
+// bill; thin coloured lines still cover this many at ScanDpi
+const double ColorPixelFraction = 0.00002;
+
+struct Sums {
+  quint64 red = 0;
+  quint64 green = 0;
+  quint64 blue = 0;
+  // Sum of every pixel's lightest channel; what is missing from it is black
+  quint64 lightest = 0;
+  quint64 inked = 0;
+  quint64 colored = 0;
+};
+
+// Adds one row of 32-bit pixels to the sums. The naive CMYK split needs
+// only channel sums: black is 255 - max(r, g, b) and cyan max - r, so no
+// per-pixel division is involved. A pixel's chroma is max - min.
+void scanRow(const quint32 *pixels, int count, Sums *sums) {
+  int i = 0;
+
+#if defined(__SSE2__)
+  // Four pixels per step. Shifting each pixel down by one and two bytes
+  // lines green and red up under blue, so byte-wise max and min give the
+  // lightest and darkest channel in the low byte; _mm_sad_epu8 against zero
+  // then sums the masked bytes into two 64-bit lanes.
+  const __m128i low = _mm_set1_epi32(0xff);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i threshold = _mm_set1_epi32(InkThreshold);
+  const __m128i chromaThreshold = _mm_set1_epi32(ChromaThreshold);
+
+  __m128i red = zero;
+  __m128i green = zero;
+  __m128i blue = zero;
+  __m128i lightest = zero;
+  __m128i inked = zero;
+  __m128i colored = zero;
+
+  for (; i + 4 <= count; i += 4) {
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+    __m128i g = _mm_srli_epi32(b, 8);
+    __m128i r = _mm_srli_epi32(b, 16);
+
+    __m128i maximum = _mm_and_si128(_mm_max_epu8(b, _mm_max_epu8(g, r)), low);
+    __m128i minimum = _mm_and_si128(_mm_min_epu8(b, _mm_min_epu8(g, r)), low);
+
+    blue = _mm_add_epi64(blue, _mm_sad_epu8(_mm_and_si128(b, low), zero));
+    green = _mm_add_epi64(green, _mm_sad_epu8(_mm_and_si128(g, low), zero));
+    red = _mm_add_epi64(red, _mm_sad_epu8(_mm_and_si128(r, low), zero));
+    lightest = _mm_add_epi64(lightest, _mm_sad_epu8(maximum, zero));
+
+    // Comparisons yield -1 per matching pixel
+    inked = _mm_sub_epi32(inked, _mm_cmplt_epi32(minimum, threshold));
+    colored = _mm_sub_epi32(
+        colored, _mm_cmpgt_epi32(_mm_sub_epi32(maximum, minimum),
+                                 chromaThreshold));
+  }
+
+  auto sum64 = [](__m128i v) {
+    alignas(16) quint64 lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), v);
+    return lanes[0] + lanes[1];
+  };
+
+  auto sum32 = [](__m128i v) {
+    alignas(16) quint32 lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), v);
+    return quint64(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+  };
+
+  sums->red += sum64(red);
+  sums->green += sum64(green);
+  sums->blue += sum64(blue);
+  sums->lightest += sum64(lightest);
+  sums->inked += sum32(inked);
+  sums->colored += sum32(colored);
+#endif
+
+  for (; i < count; i++) {
+    int r = qRed(pixels[i]);
+    int g = qGreen(pixels[i]);
+    int b = qBlue(pixels[i]);
+
+    sums->red += r;
+    sums->green += g;
+    sums->blue += b;
+    int maximum = qMax(r, qMax(g, b));
+    int minimum = qMin(r, qMin(g, b));
+    sums->lightest += maximum;
+    if (minimum < InkThreshold)
+      sums->inked++;
+    if (maximum - minimum > ChromaThreshold)
+      sums->colored++;
+  }
+}
+
+} // namespace
+
+InkCoverage::InkCoverage(QObject *parent)
+    : QObject(parent), m_loadMode(Document::ReadFile), m_documentRevision(0),
+      m_pageCount(0), m_paused(false), m_stopping(false) {
+  for (int i = 0; i < ScanThreads; i++) {
+    QThread *worker = QThread::create([this]() { scanLoop(); });
+    worker->start(QThread::LowPriority);
+    m_workers.append(worker);
+  }
+}
+
+InkCoverage::~InkCoverage() {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_stopping = true;
+    m_queue.clear();
+  }
+  m_jobAvailable.wakeAll();
+
+  for (QThread *worker : m_workers) {
+    worker->wait();
+    delete worker;
+  }
+}
+
+void InkCoverage::setDocument(const QString &filePath,
+                              Document::LoadMode mode, int pageCount) {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    m_results.clear();
+    m_filePath = filePath;
+    m_loadMode = mode;
+    m_pageCount = pageCount;
+    m_documentRevision++;
+    enqueueMissing();
+  }
+  m_jobAvailable.wakeAll();
+}
+
+void InkCoverage::reloadDocument(int pageCount) {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    m_pageCount = pageCount;
+    m_documentRevision++;
+
+    for (auto it = m_results.begin(); it != m_results.end();) {
+      if (it.key() >= pageCount)
+        it = m_results.erase(it);
+      else
+        ++it;
+    }
+
+    enqueueMissing();
+  }
+  m_jobAvailable.wakeAll();
+}
+
+void InkCoverage::invalidatePages(const QList<int> &pageNumbers) {
+  {
+    QMutexLocker locker(&m_mutex);
+    for (int page : pageNumbers) {
+      m_results.remove(page);
+      if (page < m_pageCount)
+        m_queue.enqueue({page, QImage(), m_documentRevision});
+    }
+  }
+  m_jobAvailable.wakeAll();
+}
+
+void InkCoverage::setPaused(bool paused) {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_paused = paused;
+  }
+  m_jobAvailable.wakeAll();
+}
+
+void InkCoverage::enqueueMissing() {
+  for (int i = 0; i < m_pageCount; i++) {
+    if (!m_results.contains(i))
+      m_queue.enqueue({i, QImage(), m_documentRevision});
+  }
+}
+
+void InkCoverage::submit(int pageNumber, const QImage &image) {
+  {
+    QMutexLocker locker(&m_mutex);
+    if (pageNumber < 0 || pageNumber >= m_pageCount ||
+        m_results.contains(pageNumber))
+      return;
+
+    // The page's render job stays queued and is skipped once this is done
+    m_queue.prepend({pageNumber, image, m_documentRevision});
+
+    // Handed-in rasters sit at the front, newest first. Once the raster
+    // cache lets go of them only this queue holds their memory, and the
+    // memory budget does not see it.
+    int images = 0;
+    for (auto it = m_queue.begin();
+         it != m_queue.end() && !it->image.isNull();) {
+      if (++images > QueuedImages)
+        it = m_queue.erase(it);
+      else
+        ++it;
+    }
+  }
+  m_jobAvailable.wakeOne();
+}
+
+void InkCoverage::scanLoop() {
+  std::unique_ptr<Document> document;
+  quint64 loadedRevision = 0;
+
+  while (true) {
+    Job job;
+    QString filePath;
+    Document::LoadMode loadMode;
+    bool idle;
+
+    {
+      QMutexLocker locker(&m_mutex);
+      idle = m_queue.isEmpty() || m_paused;
+    }
+
+    // Finished and paused scans let go of their document, so documents
+    // open in the background cost no more than their results
+    if (idle)
+      document.reset();
+
+    {
+      QMutexLocker locker(&m_mutex);
+      while ((m_queue.isEmpty() || m_paused) && !m_stopping)
+        m_jobAvailable.wait(&m_mutex);
+
+      if (m_stopping)
+        return;
+
+      job = m_queue.dequeue();
+      if (job.revision != m_documentRevision ||
+          m_results.contains(job.pageNumber))
+        continue;
+
+      filePath = m_filePath;
+      loadMode = m_loadMode;
+    }
+
+    QImage image = job.image;
+    if (image.isNull()) {
+      if (!document || job.revision != loadedRevision) {
+        document = std::make_unique<Document>();
+        document->load(filePath, loadMode);
+        loadedRevision = job.revision;
+      }
+      image = document->renderPage(job.pageNumber, ScanDpi);
+    }
+
+    if (image.isNull())
+      continue;
+
+    Result result;
+    {
+      TraceSpan span("ink", job.pageNumber);
+      result = measure(image);
+    }
+
+    {
+      QMutexLocker locker(&m_mutex);
+      if (job.revision != m_documentRevision)
+        continue;
+      m_results.insert(job.pageNumber, result);
+    }
+
+    emit pageScanned(job.pageNumber);
+  }
+}
+
+InkCoverage::Result InkCoverage::measure(const QImage &image) {
+  Result result;
+  if (image.isNull())
+    return result;
+
+  QImage pixels = image;
+  if (pixels.format() != QImage::Format_RGB32 &&
+      pixels.format() != QImage::Format_ARGB32 &&
+      pixels.format() != QImage::Format_ARGB32_Premultiplied)
+    pixels = pixels.convertToFormat(QImage::Format_RGB32);
+
+  Sums sums;
+  for (int y = 0; y < pixels.height(); y++)
+    scanRow(reinterpret_cast<const quint32 *>(pixels.constScanLine(y)),
+            pixels.width(), &sums);
+
+  double area = double(pixels.width()) * pixels.height();
+  double full = 255.0 * area;
+
+  result.cyan = 100.0 * (sums.lightest - sums.red) / full;
+  result.magenta = 100.0 * (sums.lightest - sums.green) / full;
+  result.yellow = 100.0 * (sums.lightest - sums.blue) / full;
+  result.black = 100.0 * (full - sums.lightest) / full;
+  result.inked = sums.inked / area;
+  result.colored = sums.colored / area;
+  result.blank = result.inked < BlankInkedFraction;
+  result.color = result.colored >= ColorPixelFraction;
+
+  return result;
+}
+
+bool InkCoverage::result(int pageNumber, Result *result) const {
+  QMutexLocker locker(&m_mutex);
+  auto it = m_results.constFind(pageNumber);
+  if (it == m_results.constEnd())
+    return false;
+
+  *result = it.value();
+  return true;
+}
+
+InkCoverage::Result InkCoverage::documentResult() const {
+  QMutexLocker locker(&m_mutex);
+  Result total;
+  if (m_results.isEmpty())
+    return total;
+
+  for (const Result &page : m_results) {
+    total.cyan += page.cyan;
+    total.magenta += page.magenta;
+    total.yellow += page.yellow;
+    total.black += page.black;
+    total.inked += page.inked;
+    total.colored += page.colored;
+  }
+
+  double count = m_results.size();
+  total.cyan /= count;
+  total.magenta /= count;
+  total.yellow /= count;
+  total.black /= count;
+  total.inked /= count;
+  total.colored /= count;
+  return total;
+}
+
+QList<int> InkCoverage::blankPages() const {
+  return pagesWhere([](const Result &page) { return page.blank; });
+}
+
+QList<int> InkCoverage::colorPages() const {
+  return pagesWhere([](const Result &page) { return page.color; });
+}
+
+QList<int> InkCoverage::monoPages() const {
+  return pagesWhere([](const Result &page) { return !page.color; });
+}
+
+QList<int> InkCoverage::pagesWhere(bool (*matches)(const Result &)) const {
+  QList<int> pages;
+
+  {
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_results.constBegin(); it != m_results.constEnd(); ++it) {
+      if (matches(it.value()))
+        pages.append(it.key());
+    }
+  }
+
+  std::sort(pages.begin(), pages.end());
+  return pages;
+}
+
+int InkCoverage::scannedPages() const {
+  QMutexLocker locker(&m_mutex);
+  return m_results.size();
+}
+
+int InkCoverage::pageCount() const {
+  QMutexLocker locker(&m_mutex);
+  return m_pageCount;
+}
+
+bool InkCoverage::isComplete() const {
+  QMutexLocker locker(&m_mutex);
+  return m_results.size() >= m_pageCount;
+}
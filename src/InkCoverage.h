@@ -0,0 +1,104 @@
+#ifndef INKCOVERAGE_H_
+#define INKCOVERAGE_H_
+
+#include "Document.h"
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+#include <QWaitCondition>
+
+class QThread;
+
+// Toner coverage and colour use per page, measured by background threads that
+// each open their own Document. Every page is rendered once at a low DPI;
+// rasters the viewer already has can be handed in instead and jump the
+// queue. Coverage uses a naive CMYK split without colour management, which
+// is what page-and-coverage billing needs, not a proof.
+class InkCoverage : public QObject {
+  Q_OBJECT
+
+public:
+  static const int ScanThreads = 2;
+  // Handed-in rasters waiting to be measured at most
+  static const int QueuedImages = 4;
+
+  // Channels are percentages of the page area at full ink; total() is
+  // their sum, so a solid black page is 100 and solid red 200
+  struct Result {
+    double cyan = 0.0;
+    double magenta = 0.0;
+    double yellow = 0.0;
+    double black = 0.0;
+    // Fractions of pixels that are visibly not paper, and visibly not gray
+    double inked = 0.0;
+    double colored = 0.0;
+    bool blank = false;
+    bool color = false;
+
+    double total() const { return cyan + magenta + yellow + black; }
+  };
+
+  explicit InkCoverage(QObject *parent = nullptr);
+  ~InkCoverage();
+
+  void setDocument(const QString &filePath, Document::LoadMode mode,
+                   int pageCount);
+  // The file was rewritten in place; results are kept until
+  // invalidatePages() drops the ones that changed
+  void reloadDocument(int pageCount);
+  void invalidatePages(const QList<int> &pageNumbers);
+  // Paused scanning holds no document open and keeps its queue
+  void setPaused(bool paused);
+
+  // Measures a colour raster of the page unless the page is done already.
+  // Only the newest few wait; older ones are dropped, and their pages are
+  // scanned from a low-DPI render like the rest.
+  void submit(int pageNumber, const QImage &image);
+
+  bool result(int pageNumber, Result *result) const;
+  // Averages over the pages measured so far
+  Result documentResult() const;
+  QList<int> blankPages() const;
+  QList<int> colorPages() const;
+  // Pages measured to have no colour; unmeasured pages are in neither list
+  QList<int> monoPages() const;
+  int scannedPages() const;
+  int pageCount() const;
+  bool isComplete() const;
+
+  static Result measure(const QImage &image);
+
+signals:
+  // Emitted from the scanning threads, connect with a queued connection
+  void pageScanned(int pageNumber);
+
+private:
+  struct Job {
+    int pageNumber;
+    QImage image;
+    quint64 revision;
+  };
+
+  void scanLoop();
+  void enqueueMissing();
+  QList<int> pagesWhere(bool (*matches)(const Result &)) const;
+
+  QList<QThread *> m_workers;
+
+  mutable QMutex m_mutex;
+  QWaitCondition m_jobAvailable;
+  QQueue<Job> m_queue;
+  QString m_filePath;
+  Document::LoadMode m_loadMode;
+  quint64 m_documentRevision;
+  int m_pageCount;
+  bool m_paused;
+  bool m_stopping;
+  QHash<int, Result> m_results;
+};
+
+#endif // INKCOVERAGE_H_
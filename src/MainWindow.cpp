@@ -1,58 +1,172 @@
 #include "MainWindow.h"
+#include "Grayscale.h"
+#include "Imposition.h"
 #include "PrintSettings.h"
+#include "SmoothScroller.h"
+#include "SystemMemory.h"
+#include "Trace.h"
 #include <QApplication>
-#include <QBoxLayout>
 #include <QFileInfo>
-#include <QFrame>
+#include <QHBoxLayout>
 #include <QKeyEvent>
 #include <QLabel>
-#include <QLayoutItem>
-#include <QList>
 #include <QPixmap>
-#include <QScrollArea>
 #include <QScrollBar>
 #include <QStatusBar>
+#include <QTabBar>
 #include <QVBoxLayout>
 #include <QWidget>
-#include <climits>
+#include <QtMath>
+#include <algorithm>
 #include <qnamespace.h>
 
+namespace {
+
+// Page rasters in the cache and on screen together, unless :set cachemb
+// says otherwise. Room for a few screens of pages at high zoom.
+const qint64 DefaultMemoryBudget = 384ll * 1024 * 1024;
+
+// Below this fraction of installed memory available the system is short,
+// and the budget shrinks by PressureDivisor
+const double PressureFraction = 0.1;
+const int PressureDivisor = 4;
+
+// Sheets prefetched ahead of a fast scroll at most
+const int MaxLookahead = 8;
+
+QPixmap uploadRaster(const QImage &image, int pageNumber, double dpi) {
+  TraceSpan span("upload", pageNumber, dpi);
+  return QPixmap::fromImage(image);
+}
+
+} // namespace
+
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), m_currentPage(0), m_dpi(150.0), m_pageGap(20),
-      m_scrollAmount(100), m_showPageBoundaries(true),
-      m_pageBoundaryColor(68, 68, 68), m_printSettings(), m_scrollArea(nullptr),
-      m_contentWidget(nullptr), m_contentLayout(nullptr), m_InputState(NORMAL),
+    : QMainWindow(parent), m_activeTab(-1), m_nextDocumentId(1),
+      m_tabBar(nullptr), m_documentId(-1), m_document(nullptr),
+      m_loadMode(Document::ReadFile), m_currentPage(0),
+      m_dpi(150.0), m_pageGap(20), m_scrollAmount(100), m_prefetchPages(2),
+      m_evictDistance(6),
+      m_tiledPixelThreshold(4096 * 4096), m_previewDivisor(4.0),
+      m_showPageBoundaries(true), m_pageBoundaryColor(68, 68, 68),
+      m_printSettings(), m_canvas(nullptr), m_scroller(nullptr),
+      m_thumbnailPanel(nullptr),
+      m_renderEngine(nullptr),
+      m_keepFirst(0), m_keepLast(-1), m_memoryBudget(DefaultMemoryBudget),
+      m_memoryPressure(false), m_memoryTier(0), m_memoryTimer(nullptr),
+      m_printJob(nullptr), m_watcher(nullptr),
+      m_textIndex(nullptr), m_currentHit(-1), m_inkCoverage(nullptr),
+      m_skipBlankPages(false), m_colorSplit(SplitOff),
+      m_InputState(NORMAL),
       m_numberBuffer(""), m_commandInput(nullptr) {
   setWindowTitle("CtrlP");
   resize(800, 600);
   setupUI();
 
+  m_renderEngine = new RenderEngine(this);
+  connect(m_renderEngine, &RenderEngine::pageRendered, this,
+          &MainWindow::onPageRendered);
+  connect(m_renderEngine, &RenderEngine::tileRendered, this,
+          &MainWindow::onTileRendered);
+
+  // An active search picks up pages as they are indexed, batched so a fast
+  // indexer does not re-run it for every page
+  m_searchRefreshTimer = new QTimer(this);
+  m_searchRefreshTimer->setSingleShot(true);
+  m_searchRefreshTimer->setInterval(300);
+  connect(m_searchRefreshTimer, &QTimer::timeout, this,
+          &MainWindow::refreshSearch);
+
   m_keySequenceTimer = new QTimer(this);
   m_keySequenceTimer->setSingleShot(true);
   m_keySequenceTimer->setInterval(1000);
   connect(m_keySequenceTimer, &QTimer::timeout, this,
           &MainWindow::resetKeySequence);
 
-  updateStatusBar();
+  // Zoom repaints the current rasters scaled right away and only re-renders
+  // once zoom input has been quiet for a moment
+  m_zoomSettleTimer = new QTimer(this);
+  m_zoomSettleTimer->setSingleShot(true);
+  m_zoomSettleTimer->setInterval(200);
+  connect(m_zoomSettleTimer, &QTimer::timeout, this,
+          &MainWindow::updateVisiblePages);
+
+  // The overlay samples the counters instead of repainting on every change
+  m_hudTimer = new QTimer(this);
+  m_hudTimer->setInterval(500);
+  connect(m_hudTimer, &QTimer::timeout, this, &MainWindow::updateHud);
+
+  // Memory pressure comes from other processes too, so it is polled
+  m_memoryTimer = new QTimer(this);
+  m_memoryTimer->setInterval(2000);
+  connect(m_memoryTimer, &QTimer::timeout, this,
+          &MainWindow::checkMemoryPressure);
+  m_memoryTimer->start();
+  checkMemoryPressure();
+  enforceMemoryBudget();
+
+  // The first document opens in this tab instead of a new one
+  createTab();
+  activateTab(0);
 }
 
-void MainWindow::setupUI() {
-  m_contentWidget = new QWidget();
-  m_contentWidget->setStyleSheet("background-color: black;");
+MainWindow::~MainWindow() {
+  // Stop the background threads before the documents they were opened for
+  for (auto &tab : m_tabs) {
+    delete tab->textIndex;
+    delete tab->inkCoverage;
+    delete tab->watcher;
+  }
+}
 
-  m_contentLayout = new QVBoxLayout(m_contentWidget);
-  m_contentLayout->setAlignment(Qt::AlignHCenter | Qt::AlignTop);
-  m_contentLayout->setSpacing(0);
-  m_contentLayout->setContentsMargins(0, 20, 0, 20);
+void MainWindow::setupUI() {
+  m_canvas = new PageCanvas(this);
+  m_canvas->setPrintSettings(&m_printSettings);
+  m_canvas->setPageGap(m_pageGap);
+  m_canvas->setPageBoundaries(m_showPageBoundaries, m_pageBoundaryColor);
+  m_canvas->setTiledPixelThreshold(m_tiledPixelThreshold);
+
+  // j and k glide; jumps and drags move the scroll bar directly
+  m_scroller = new SmoothScroller(m_canvas->verticalScrollBar(), this);
+
+  m_thumbnailPanel = new ThumbnailPanel(this);
+  m_thumbnailPanel->setVisible(false);
+
+  // Hidden until a second document is open
+  m_tabBar = new QTabBar(this);
+  m_tabBar->setAutoHide(true);
+  m_tabBar->setTabsClosable(true);
+  m_tabBar->setDocumentMode(true);
+  m_tabBar->setExpanding(false);
+  m_tabBar->setFocusPolicy(Qt::NoFocus);
+
+  QWidget *central = new QWidget(this);
+  QVBoxLayout *column = new QVBoxLayout(central);
+  column->setContentsMargins(0, 0, 0, 0);
+  column->setSpacing(0);
+  column->addWidget(m_tabBar);
+
+  QHBoxLayout *layout = new QHBoxLayout();
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->setSpacing(0);
+  layout->addWidget(m_thumbnailPanel);
+  layout->addWidget(m_canvas, 1);
+  column->addLayout(layout, 1);
+
+  setCentralWidget(central);
+
+  connect(m_tabBar, &QTabBar::currentChanged, this, [this](int index) {
+    if (index >= 0 && index != m_activeTab)
+      activateTab(index);
+  });
+  connect(m_tabBar, &QTabBar::tabCloseRequested, this,
+          &MainWindow::closeTab);
 
-  m_scrollArea = new QScrollArea(this);
-  m_scrollArea->setWidget(m_contentWidget);
-  m_scrollArea->setWidgetResizable(true);
-  m_scrollArea->setStyleSheet("background-color: black; border: none;");
-  m_scrollArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-  m_scrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+  connect(m_thumbnailPanel, &ThumbnailPanel::pageActivated, this,
+          &MainWindow::jumpToPage);
 
-  setCentralWidget(m_scrollArea);
+  connect(m_canvas, &PageCanvas::viewChanged, this,
+          &MainWindow::updateVisiblePages);
 
   m_commandInput = new QLineEdit(this);
   m_commandInput->setStyleSheet("QLineEdit {"
@@ -66,9 +180,12 @@ void MainWindow::setupUI() {
 
   statusBar()->addPermanentWidget(m_commandInput);
 
+  // Leave command mode first so the command's own status message is not
+  // replaced by the page status
   connect(m_commandInput, &QLineEdit::returnPressed, [this]() {
-    executeCommand(m_commandInput->text());
+    QString command = m_commandInput->text();
     exitCommandMode();
+    executeCommand(command);
   });
 
   statusBar()->showMessage("No document loaded");
@@ -98,7 +215,7 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
 
   case Qt::Key_G:
     if (shift) {
-      jumpToPage(m_document.pageCount() - 1);
+      jumpToPage(m_document->pageCount() - 1);
     } else {
       if (m_InputState == AWAITING_G) {
         jumpToPage(0);
@@ -115,8 +232,18 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
     enterCommandMode();
     break;
 
+  case Qt::Key_Slash:
+    enterCommandMode("/");
+    break;
+
+  case Qt::Key_N:
+    resetKeySequence();
+    stepHit(shift ? -1 : 1);
+    break;
+
   case Qt::Key_Escape:
     resetKeySequence();
+    clearSearch();
     updateStatusBar();
     break;
 
@@ -207,6 +334,29 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
     cycleScaleMode();
     break;
 
+  case Qt::Key_U:
+    resetKeySequence();
+    cyclePageLayout();
+    break;
+
+  case Qt::Key_T:
+    if (m_InputState == AWAITING_G) {
+      // gt and gT step through tabs, {count}gt goes to a tab
+      bool ok;
+      int count = m_numberBuffer.toInt(&ok);
+      if (ok && count > 0 && !shift) {
+        if (count <= int(m_tabs.size()))
+          activateTab(count - 1);
+      } else {
+        cycleTab(shift ? -1 : 1);
+      }
+      resetKeySequence();
+      break;
+    }
+    resetKeySequence();
+    toggleThumbnails();
+    break;
+
   default:
     if (event->modifiers() == Qt::NoModifier || key == Qt::Key_Shift ||
         key == Qt::Key_Control || key == Qt::Key_Alt || key == Qt::Key_Meta) {
@@ -218,34 +368,423 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
   }
 }
 
+void MainWindow::enableDiskCache(const QString &directory, qint64 maxBytes) {
+  m_diskCache = std::make_shared<DiskCache>(directory, maxBytes);
+  m_renderEngine->setDiskCache(m_diskCache);
+}
+
 bool MainWindow::loadDocument(const QString &filePath) {
-  if (m_document.load(filePath)) {
-    m_currentPage = 0;
-    updateStatusBar();
-    renderAllPages();
+  // An empty tab is reused, so the first document does not open a second one
+  bool reuse = activeTab() && !activeTab()->document->isLoaded();
+  DocumentTab *tab = reuse ? activeTab() : createTab();
+
+  // Taken before loading, so a rewrite during the load shows up as a
+  // mismatch rather than slipping in between the load and the watch
+  QByteArray fingerprint = DiskCache::contentHash(filePath);
+
+  if (!tab->document->load(filePath, m_loadMode)) {
+    statusBar()->showMessage("Error: " + tab->document->errorString());
+    if (!reuse)
+      closeTab(int(m_tabs.size()) - 1);
+    return false;
+  }
 
-    // Update window title with document name
-    QString fileName = QFileInfo(filePath).fileName();
-    setWindowTitle(QString("CtrlP - %1").arg(fileName));
+  int pageCount = tab->document->pageCount();
+  tab->contentHash = m_diskCache ? fingerprint : QByteArray();
+  m_renderEngine->setDocument(tab->id, filePath, m_loadMode,
+                              tab->contentHash);
+  tab->textIndex->setDocument(filePath, m_loadMode, pageCount);
+  tab->inkCoverage->setDocument(filePath, m_loadMode, pageCount);
+  if (m_loadMode == Document::ReadFile)
+    tab->watcher->watch(filePath, fingerprint);
+
+  // A new document starts from the current print settings and zoom, but
+  // none of the previous document's page selections
+  tab->printSettings = m_printSettings;
+  tab->printSettings.excludedPages.clear();
+  tab->printSettings.grayscalePages.clear();
+  tab->currentPage = 0;
+  tab->dpi = m_dpi;
+  tab->scroll = QPoint();
+  tab->searchPattern.clear();
+  tab->searchHits.clear();
+  tab->currentHit = -1;
+  tab->skipBlankPages = m_skipBlankPages;
+  tab->colorSplit = m_colorSplit;
+
+  int index = reuse ? m_activeTab : int(m_tabs.size()) - 1;
+
+  QFileInfo info(filePath);
+  m_tabBar->setTabText(index, info.fileName());
+  m_tabBar->setTabToolTip(index, info.absoluteFilePath());
+
+  activateTab(index);
 
-    return true;
-  } else {
-    statusBar()->showMessage("Error: " + m_document.errorString());
-    return false;
+  statusBar()->showMessage(
+      QString("Loaded in %1 ms (%2) | RSS %3 MB")
+          .arg(tab->document->loadTimeMs(), 0, 'f', 1)
+          .arg(m_loadMode == Document::MemoryMap ? "mapped, not watched"
+                                                 : "read")
+          .arg(SystemMemory::residentKB() / 1024.0, 0, 'f', 1),
+      4000);
+
+  return true;
+}
+
+void MainWindow::reloadDocument() {
+  if (!m_document->isLoaded())
+    return;
+
+  QString filePath = m_document->filePath();
+
+  // A half-written file keeps the current document; the write that
+  // finishes it triggers another reload
+  QByteArray fingerprint = DiskCache::contentHash(filePath);
+  Document reloaded;
+  if (!reloaded.load(filePath, m_loadMode)) {
+    statusBar()->showMessage("Reload failed: " + reloaded.errorString(),
+                             3000);
+    return;
+  }
+
+  int scroll = m_canvas->verticalScrollBar()->value();
+  int hscroll = m_canvas->horizontalScrollBar()->value();
+
+  // The canvas and thumbnails keep pointing at the same Document
+  *m_document = std::move(reloaded);
+
+  m_contentHash = m_diskCache ? fingerprint : QByteArray();
+  activeTab()->contentHash = m_contentHash;
+  m_renderEngine->setDocument(m_documentId, filePath, m_loadMode,
+                              m_contentHash);
+  m_pendingPages.clear();
+  m_pendingPreviews.clear();
+  m_pendingTiles.clear();
+  m_textIndex->setDocument(filePath, m_loadMode, m_document->pageCount());
+  clearSearch();
+  m_inkCoverage->reloadDocument(m_document->pageCount());
+
+  // Rasters stay on screen until the page signatures say which are stale
+  m_canvas->documentReloaded();
+  m_thumbnailPanel->reloadDocument();
+  if (m_canvas->isImposed())
+    updateImposition();
+
+  m_currentPage = qMin(m_currentPage, m_document->pageCount() - 1);
+  m_canvas->verticalScrollBar()->setValue(scroll);
+  m_canvas->horizontalScrollBar()->setValue(hscroll);
+  updateVisiblePages();
+  updateStatusBar();
+
+  // Pages on screen are compared first, then the rest of the kept sheets
+  QList<int> firstPages;
+  for (int i = m_canvas->firstVisibleSheet();
+       i >= 0 && i <= m_canvas->lastVisibleSheet(); i++)
+    firstPages += m_canvas->pagesOnSheet(i);
+  for (int i = qMax(0, m_keepFirst);
+       i <= qMin(m_canvas->sheetCount() - 1, m_keepLast); i++)
+    firstPages += m_canvas->pagesOnSheet(i);
+  m_watcher->rescan(fingerprint, firstPages);
+}
+
+void MainWindow::onPagesChanged(int documentId, const QList<int> &pages) {
+  DocumentTab *tab = findTab(documentId);
+  if (!tab)
+    return;
+
+  for (int page : pages)
+    m_rasterCache.removePage(documentId, page);
+  tab->inkCoverage->invalidatePages(pages);
+
+  // Background tabs repaint from scratch when they are shown again
+  if (documentId != m_documentId)
+    return;
+
+  for (int page : pages)
+    m_canvas->invalidatePage(page);
+  m_thumbnailPanel->invalidatePages(pages);
+
+  updateVisiblePages();
+}
+
+void MainWindow::enforceMemoryBudget() {
+  qint64 budget =
+      m_memoryPressure ? m_memoryBudget / PressureDivisor : m_memoryBudget;
+
+  // The cache gets what the canvas leaves, so its least recently used
+  // rasters, none of them on screen, are the first to go
+  qint64 canvasBytes = m_canvas->rasterBytes();
+  int tier = canvasBytes + m_rasterCache.usedBytes() > budget ? 1 : 0;
+  m_rasterCache.setMaxBytes(qMax<qint64>(0, budget - canvasBytes));
+
+  if (canvasBytes > budget) {
+    QSet<int> visible;
+    for (int i = m_canvas->firstVisibleSheet();
+         i >= 0 && i <= m_canvas->lastVisibleSheet(); i++) {
+      for (int page : m_canvas->pagesOnSheet(i))
+        visible.insert(page);
+    }
+
+    // Pages kept around the view, farthest first. They are downscaled to
+    // preview size before any is dropped to a placeholder; visible pages
+    // are never touched.
+    QList<int> offscreen;
+    for (int page : m_canvas->rasterPages()) {
+      if (!visible.contains(page))
+        offscreen.append(page);
+    }
+    std::sort(offscreen.begin(), offscreen.end(), [this](int a, int b) {
+      return qAbs(a - m_currentPage) > qAbs(b - m_currentPage);
+    });
+
+    for (int i = 0; i < offscreen.size() && canvasBytes > budget; i++) {
+      m_canvas->downscalePage(offscreen[i], m_previewDivisor);
+      canvasBytes = m_canvas->rasterBytes();
+      tier = 2;
+    }
+    for (int i = 0; i < offscreen.size() && canvasBytes > budget; i++) {
+      m_canvas->clearPage(offscreen[i]);
+      canvasBytes = m_canvas->rasterBytes();
+      tier = 3;
+    }
+  }
+
+  // Prefetching resumes once there is room for it again, not as soon as
+  // the last eviction made some
+  if (tier < m_memoryTier && canvasBytes > budget * 3 / 4)
+    tier = m_memoryTier;
+  m_memoryTier = tier;
+}
+
+void MainWindow::checkMemoryPressure() {
+  qint64 available = SystemMemory::availableKB();
+  qint64 total = SystemMemory::totalKB();
+  bool pressure =
+      available >= 0 && total > 0 && available < total * PressureFraction;
+  if (pressure == m_memoryPressure)
+    return;
+
+  m_memoryPressure = pressure;
+  m_memoryTier = 0;
+  enforceMemoryBudget();
+
+  if (pressure)
+    statusBar()->showMessage("System memory low: keeping fewer pages", 3000);
+  else
+    updateVisiblePages();
+}
+
+MainWindow::DocumentTab *MainWindow::createTab() {
+  auto tab = std::make_unique<DocumentTab>();
+  tab->id = m_nextDocumentId++;
+  tab->document = std::make_unique<Document>();
+  tab->reloadPending = false;
+  tab->printSettings = m_printSettings;
+  tab->currentPage = 0;
+  tab->dpi = m_dpi;
+  tab->currentHit = -1;
+  tab->skipBlankPages = m_skipBlankPages;
+  tab->colorSplit = m_colorSplit;
+
+  // Signals are matched to their tab by id, since they can still be queued
+  // when the tab closes
+  int id = tab->id;
+
+  tab->textIndex = new TextIndex(this);
+  connect(tab->textIndex, &TextIndex::progress, this, [this, id]() {
+    if (id == m_documentId && !m_searchPattern.isEmpty() &&
+        !m_searchRefreshTimer->isActive())
+      m_searchRefreshTimer->start();
+  });
+
+  // Coverage shows up in the status bar once the current page is measured,
+  // and the document's once every page is
+  tab->inkCoverage = new InkCoverage(this);
+  connect(tab->inkCoverage, &InkCoverage::pageScanned, this,
+          [this, id](int page) {
+            if (id != m_documentId)
+              return;
+            bool complete = m_inkCoverage->isComplete();
+            if (complete && (m_skipBlankPages || m_colorSplit != SplitOff))
+              applyPageFilters();
+            if (page == m_currentPage || complete)
+              updateStatusBar();
+          });
+
+  // Rewrites of the open file reload it in place; only the pages whose
+  // content differs are rendered again. Background tabs wait until shown.
+  tab->watcher = new DocumentWatcher(this);
+  connect(tab->watcher, &DocumentWatcher::fileChanged, this, [this, id]() {
+    if (id == m_documentId)
+      reloadDocument();
+    else if (DocumentTab *changed = findTab(id))
+      changed->reloadPending = true;
+  });
+  connect(tab->watcher, &DocumentWatcher::pagesChanged, this,
+          [this, id](const QList<int> &pages) { onPagesChanged(id, pages); });
+  connect(tab->watcher, &DocumentWatcher::rescanned, this,
+          [this, id](int changedPages, int pageCount) {
+            if (id == m_documentId)
+              statusBar()->showMessage(
+                  QString("Reloaded: %1 of %2 pages changed")
+                      .arg(changedPages)
+                      .arg(pageCount),
+                  3000);
+          });
+
+  m_tabs.push_back(std::move(tab));
+  m_tabBar->addTab("No document");
+  return m_tabs.back().get();
+}
+
+MainWindow::DocumentTab *MainWindow::activeTab() const {
+  if (m_activeTab < 0 || m_activeTab >= int(m_tabs.size()))
+    return nullptr;
+  return m_tabs[m_activeTab].get();
+}
+
+MainWindow::DocumentTab *MainWindow::findTab(int documentId) const {
+  for (const auto &tab : m_tabs) {
+    if (tab->id == documentId)
+      return tab.get();
   }
+  return nullptr;
+}
+
+void MainWindow::saveTabState() {
+  DocumentTab *tab = activeTab();
+  if (!tab)
+    return;
+
+  tab->printSettings = m_printSettings;
+  tab->currentPage = m_currentPage;
+  tab->dpi = m_dpi;
+  tab->scroll = QPoint(m_canvas->horizontalScrollBar()->value(),
+                       m_canvas->verticalScrollBar()->value());
+  tab->searchPattern = m_searchPattern;
+  tab->searchHits = m_searchHits;
+  tab->currentHit = m_currentHit;
+  tab->skipBlankPages = m_skipBlankPages;
+  tab->colorSplit = m_colorSplit;
+}
+
+void MainWindow::activateTab(int index) {
+  if (index < 0 || index >= int(m_tabs.size()))
+    return;
+
+  // Only the visible tab indexes and measures; the others keep their
+  // results and queues but give their threads' documents back
+  if (DocumentTab *previous = activeTab()) {
+    if (index != m_activeTab) {
+      saveTabState();
+      previous->textIndex->setPaused(true);
+      previous->inkCoverage->setPaused(true);
+    }
+  }
+
+  m_activeTab = index;
+  DocumentTab *tab = m_tabs[index].get();
+  m_documentId = tab->id;
+  m_document = tab->document.get();
+  m_textIndex = tab->textIndex;
+  m_inkCoverage = tab->inkCoverage;
+  m_watcher = tab->watcher;
+  m_contentHash = tab->contentHash;
+
+  m_printSettings = tab->printSettings;
+  m_currentPage = tab->currentPage;
+  m_dpi = tab->dpi;
+  m_searchPattern = tab->searchPattern;
+  m_searchHits = tab->searchHits;
+  m_currentHit = tab->currentHit;
+  m_skipBlankPages = tab->skipBlankPages;
+  m_colorSplit = tab->colorSplit;
+
+  m_textIndex->setPaused(false);
+  m_inkCoverage->setPaused(false);
+
+  // The pool only works for the visible tab; rasters of the others stay in
+  // the shared cache until it needs the room
+  m_renderEngine->setActiveDocument(m_documentId);
+  m_pendingPages.clear();
+  m_pendingPreviews.clear();
+  m_pendingTiles.clear();
+
+  clearPages();
+  m_canvas->setDocument(m_document);
+  m_thumbnailPanel->setDocument(m_document);
+  updateImposition();
+  m_canvas->setDPI(m_dpi);
+  m_canvas->horizontalScrollBar()->setValue(tab->scroll.x());
+  m_canvas->verticalScrollBar()->setValue(tab->scroll.y());
+  updateSearchHighlights();
+  updateVisiblePages();
+
+  if (m_document->isLoaded())
+    setWindowTitle(QString("CtrlP - %1")
+                       .arg(QFileInfo(m_document->filePath()).fileName()));
+  else
+    setWindowTitle("CtrlP");
+
+  m_tabBar->setCurrentIndex(index);
+  updateStatusBar();
+
+  if (tab->reloadPending) {
+    tab->reloadPending = false;
+    reloadDocument();
+  }
+}
+
+void MainWindow::closeTab(int index) {
+  if (index < 0 || index >= int(m_tabs.size()))
+    return;
+
+  if (m_tabs.size() == 1) {
+    statusBar()->showMessage("Cannot close the last tab", 2000);
+    return;
+  }
+
+  if (index == m_activeTab)
+    activateTab(index + 1 < int(m_tabs.size()) ? index + 1 : index - 1);
+
+  std::unique_ptr<DocumentTab> tab = std::move(m_tabs[index]);
+  m_tabs.erase(m_tabs.begin() + index);
+  if (index < m_activeTab)
+    m_activeTab--;
+
+  m_renderEngine->removeDocument(tab->id);
+  m_rasterCache.removeDocument(tab->id);
+  delete tab->textIndex;
+  delete tab->inkCoverage;
+  delete tab->watcher;
+
+  // Removing a tab before the current one moves the bar's selection, which
+  // must not activate anything
+  m_tabBar->blockSignals(true);
+  m_tabBar->removeTab(index);
+  m_tabBar->setCurrentIndex(m_activeTab);
+  m_tabBar->blockSignals(false);
+}
+
+void MainWindow::cycleTab(int step) {
+  int count = int(m_tabs.size());
+  if (count < 2)
+    return;
+
+  activateTab(((m_activeTab + step) % count + count) % count);
 }
 
 void MainWindow::updateStatusBar() {
-  if (!m_document.isLoaded()) {
+  if (!m_document->isLoaded()) {
     statusBar()->showMessage("No document loaded");
     return;
   }
 
-  int totalPages = m_document.pageCount();
+  int totalPages = m_document->pageCount();
   int displayPage = m_currentPage + 1;
 
-  QSizeF sizeMM = m_document.pageSizeMM(m_currentPage);
-  QString paperSize = Document::detectPaperSize(sizeMM);
+  QSizeF sizeMM = m_document->pageSizeMM(m_currentPage);
+  QString paperSize = m_document->paperSize(m_currentPage);
 
   QString msg = QString(" [%1/%2] | %3 x %4 mm (%5)")
                     .arg(displayPage)
@@ -254,146 +793,459 @@ void MainWindow::updateStatusBar() {
                     .arg(sizeMM.height(), 0, 'f', 1)
                     .arg(paperSize);
 
+  if (m_printSettings.pageLayout != PrintSettings::OneUp)
+    msg += " | " + m_printSettings.pageLayoutName();
+
+  InkCoverage::Result ink;
+  if (m_inkCoverage->result(m_currentPage, &ink))
+    msg += ink.blank ? QString(" | Blank")
+                     : QString(" | Ink %1% %2")
+                           .arg(ink.total(), 0, 'f', 1)
+                           .arg(ink.color ? "color" : "mono");
+
+  if (m_inkCoverage->isComplete()) {
+    int blank = m_inkCoverage->blankPages().size();
+    msg += QString(" | Doc ink %1%")
+               .arg(m_inkCoverage->documentResult().total(), 0, 'f', 1);
+    if (blank > 0)
+      msg += QString(", %1 blank%2")
+                 .arg(blank)
+                 .arg(m_skipBlankPages ? " skipped" : "");
+    msg += QString(", %1 color").arg(m_inkCoverage->colorPages().size());
+  }
+
   statusBar()->showMessage(msg);
 }
 
-void MainWindow::renderAllPages() {
-  if (!m_document.isLoaded())
+void MainWindow::clearPages() {
+  m_canvas->clearAllPages();
+  m_keepFirst = 0;
+  m_keepLast = -1;
+}
+
+void MainWindow::layoutPages() {
+  if (!m_document->isLoaded())
     return;
 
-  QLayoutItem *item;
-  while ((item = m_contentLayout->takeAt(0)) != nullptr) {
-    delete item->widget();
-    delete item;
-  }
+  m_renderEngine->cancelAll();
+  m_scroller->stop();
+  m_pendingPages.clear();
+  m_pendingPreviews.clear();
+  m_pendingTiles.clear();
 
-  m_pageWidgets.clear();
+  // Every page is sized from its page dimensions, so the scroll range is
+  // right before anything is rasterized. Rasters from the previous zoom or
+  // color setting are kept as previews until the new ones arrive.
+  m_canvas->setDPI(m_dpi);
 
-  int pageCount = m_document.pageCount();
+  updateVisiblePages();
+}
 
-  for (int i = 0; i < pageCount; i++) {
-    QImage image = m_document.renderPage(i, m_dpi);
+void MainWindow::updateImposition() {
+  if (!m_document->isLoaded())
+    return;
 
-    if (image.isNull())
-      continue;
+  if (m_printSettings.pageLayout == PrintSettings::OneUp)
+    m_canvas->setImposition(QVector<SheetLayout>());
+  else
+    m_canvas->setImposition(Imposition::sheets(*m_document, m_printSettings));
+}
 
-    if (!m_printSettings.colorMode) {
-      image = image.convertToFormat(QImage::Format_Grayscale8);
-    }
+void MainWindow::updateVisiblePages() {
+  if (!m_document->isLoaded() || m_canvas->sheetCount() == 0)
+    return;
 
-    PageWidget *pageWidget = new PageWidget();
-    pageWidget->setPagePixmap(QPixmap::fromImage(image));
-    pageWidget->setPrintSettings(&m_printSettings);
-    pageWidget->setDPI(m_dpi);
-    pageWidget->setPageNumber(i);
-
-    m_contentLayout->addWidget(pageWidget);
-    m_pageWidgets.append(pageWidget);
-
-    if (i < pageCount - 1) {
-      m_contentLayout->addSpacing(m_pageGap);
-
-      if (m_showPageBoundaries) {
-        QFrame *separator = new QFrame();
-        separator->setFrameShape(QFrame::HLine);
-        separator->setStyleSheet(
-            QString("background-color: %1;").arg(m_pageBoundaryColor.name()));
-        separator->setFixedHeight(1);
-        separator->setMaximumWidth(image.width());
-        m_contentLayout->addWidget(separator);
+  QRect viewRect = m_canvas->viewRect();
+  int sheetCount = m_canvas->sheetCount();
+
+  int firstVisible = m_canvas->firstVisibleSheet();
+  int lastVisible = m_canvas->lastVisibleSheet();
+
+  // While scrolling, look ahead as far as the view travels in the time a
+  // page takes to render, so pages are ready as they come into view. One
+  // sheet behind is enough then.
+  double velocity = m_scroller->velocity();
+  bool up = velocity < 0.0;
+  int ahead = m_prefetchPages;
+  int behind = m_prefetchPages;
+  if (velocity != 0.0) {
+    RenderEngine::Stats render = m_renderEngine->stats();
+    double renderSeconds =
+        (render.rendered > 0 ? render.averageRenderMs : 100.0) / 1000.0;
+    int pitch = m_canvas->sheetPitch(firstVisible);
+    int travel = qCeil(qAbs(velocity) * renderSeconds / qMax(1, pitch));
+    ahead = qMin(m_prefetchPages + travel, MaxLookahead);
+    behind = qMin(1, m_prefetchPages);
+  }
+
+  int renderFirst = qMax(0, firstVisible - (up ? ahead : behind));
+  int renderLast = qMin(sheetCount - 1, lastVisible + (up ? behind : ahead));
+
+  // Visible pages with nothing to show get a quick low-DPI preview first,
+  // then the visible pages ahead of the prefetch window. Tiled pages only
+  // render what intersects the viewport, so they are not prefetched. While a
+  // zoom is settling the scaled rasters stand in and nothing is queued.
+  // Windows count sheets, which are single pages unless imposed.
+  if (!m_zoomSettleTimer->isActive()) {
+    for (int i = firstVisible; i <= lastVisible; i++) {
+      for (int page : m_canvas->pagesOnSheet(i))
+        renderPreview(page);
+    }
+    for (int i = firstVisible; i <= lastVisible; i++) {
+      for (int page : m_canvas->pagesOnSheet(i)) {
+        if (m_canvas->isTiled(page))
+          renderTiles(page, viewRect);
+        else
+          renderPage(page);
+      }
+    }
+    // Ahead in the scroll direction first, nearest sheet first. Short on
+    // memory, prefetched pages would only be evicted again.
+    auto prefetch = [this](int sheet) {
+      for (int page : m_canvas->pagesOnSheet(sheet)) {
+        if (!m_canvas->isTiled(page))
+          renderPage(page);
       }
+    };
+    if (m_memoryTier < 2) {
+      int step = up ? -1 : 1;
+      int front = up ? firstVisible : lastVisible;
+      int back = up ? lastVisible : firstVisible;
+      for (int i = front + step; i >= renderFirst && i <= renderLast;
+           i += step)
+        prefetch(i);
+      for (int i = back - step; i >= renderFirst && i <= renderLast;
+           i -= step)
+        prefetch(i);
+    }
+  }
 
-      m_contentLayout->addSpacing(m_pageGap);
+  // Keep a hysteresis band around the render window so pages do not thrash
+  // while scrolling back and forth. Only sheets leaving the previous band
+  // can hold rasters, so eviction is bounded by the band size. The band
+  // reaches as far as the longest look-ahead, or sheets prefetched during a
+  // fast scroll would be evicted once it slows and fetched again on the
+  // next key press. The memory budget still trims it when short.
+  int keepDistance = qMax(m_evictDistance, MaxLookahead);
+  int keepFirst = qMax(0, firstVisible - keepDistance);
+  int keepLast = qMin(sheetCount - 1, lastVisible + keepDistance);
+
+  for (int i = qMax(0, m_keepFirst); i <= qMin(sheetCount - 1, m_keepLast);
+       i++) {
+    if (i < keepFirst || i > keepLast) {
+      for (int page : m_canvas->pagesOnSheet(i))
+        m_canvas->clearPage(page);
     }
   }
 
-  m_currentPage = getCurrentVisiblePage();
-  updateStatusBar();
+  m_keepFirst = keepFirst;
+  m_keepLast = keepLast;
+
+  enforceMemoryBudget();
+
+  int visiblePage = getCurrentVisiblePage();
+  if (visiblePage >= 0 && visiblePage != m_currentPage) {
+    m_currentPage = visiblePage;
+    m_thumbnailPanel->setCurrentPage(m_currentPage);
+    updateStatusBar();
+  }
 }
 
-void MainWindow::scrollBy(int pixels) {
-  QScrollBar *vbar = m_scrollArea->verticalScrollBar();
-  vbar->setValue(vbar->value() + pixels);
+void MainWindow::renderPage(int pageNumber) {
+  if (m_canvas->hasPagePixmap(pageNumber) ||
+      m_pendingPages.contains(pageNumber))
+    return;
 
-  m_currentPage = getCurrentVisiblePage();
-  updateStatusBar();
+  double dpi = pageDpi(pageNumber);
+  bool color = m_printSettings.pageInColor(pageNumber);
+  QImage cached = findRaster(RasterKey(m_documentId, pageNumber, dpi, color));
+  if (!cached.isNull()) {
+    m_canvas->setPagePixmap(pageNumber,
+                            uploadRaster(cached, pageNumber, dpi));
+    return;
+  }
+
+  m_pendingPages.insert(pageNumber);
+  m_renderEngine->requestPage(pageNumber, dpi, !color);
 }
 
-void MainWindow::jumpToPage(int pageNumber) {
-  if (pageNumber < 0 || pageNumber >= m_document.pageCount())
+void MainWindow::renderPreview(int pageNumber) {
+  if (m_canvas->hasAnyPixmap(pageNumber) ||
+      m_pendingPreviews.contains(pageNumber))
     return;
 
-  if (pageNumber >= m_pageWidgets.size())
+  double dpi = previewDpi(pageNumber);
+  bool color = m_printSettings.pageInColor(pageNumber);
+  QImage cached = findRaster(RasterKey(m_documentId, pageNumber, dpi, color));
+  if (!cached.isNull()) {
+    m_canvas->setPreviewPixmap(pageNumber,
+                               uploadRaster(cached, pageNumber, dpi));
     return;
+  }
+
+  m_pendingPreviews.insert(pageNumber);
+  m_renderEngine->requestPage(pageNumber, dpi, !color);
+}
+
+QImage MainWindow::findRaster(const RasterKey &key) {
+  // One lookup counts once in the hit rate, however many keys it probes. A
+  // gray raster converted from a cached colour one is a hit.
+  bool inMemory = false;
+  QImage image = probeRaster(key, &inMemory);
+  m_rasterCache.recordLookup(inMemory);
+  return image;
+}
+
+QImage MainWindow::probeRaster(const RasterKey &key, bool *inMemory) {
+  // Until a reloaded page is compared, its cached rasters may show the old
+  // file. The disk cache is keyed by the new file's hash.
+  bool stale = key.document == m_documentId && m_watcher &&
+               m_watcher->isPending(key.pageNumber);
+
+  QImage image = stale ? QImage() : m_rasterCache.peek(key);
+  if (!image.isNull()) {
+    *inMemory = true;
+    return image;
+  }
 
-  PageWidget *targetWidget = m_pageWidgets[pageNumber];
-  m_scrollArea->ensureWidgetVisible(targetWidget, 0, 0);
+  // Disk hits are promoted so the mapping is only opened once. Tiles are
+  // never stored there.
+  if (m_diskCache && key.tile.x() < 0) {
+    image = m_diskCache->find(m_contentHash, key);
+    if (!image.isNull()) {
+      m_rasterCache.insert(key, image);
+      return image;
+    }
+  }
+
+  // A grayscale raster is a cheap transform of the colour one, and is kept
+  // beside it so toggling back and forth renders nothing
+  if (!key.colorMode) {
+    RasterKey colorKey = key;
+    colorKey.colorMode = true;
+
+    QImage color = probeRaster(colorKey, inMemory);
+    if (!color.isNull()) {
+      TraceSpan span("convert", key.pageNumber, key.dpiKey / 100.0);
+      image = Grayscale::fromColor(color);
+      m_rasterCache.insert(key, image);
+    }
+  }
+
+  return image;
+}
+
+double MainWindow::pageDpi(int pageNumber) const {
+  // Imposed pages render straight at their cell size
+  return m_dpi * m_canvas->pageScale(pageNumber);
+}
+
+double MainWindow::previewDpi(int pageNumber) const {
+  double dpi = pageDpi(pageNumber) / m_previewDivisor;
+
+  // Tiled pages are huge by definition, so cap their preview at a fraction
+  // of the tiling threshold
+  if (m_canvas->isTiled(pageNumber)) {
+    QSizeF sizePoints = m_document->pageSize(pageNumber);
+    double maxPixels = m_tiledPixelThreshold / 16.0;
+    double maxDpi =
+        72.0 * qSqrt(maxPixels / (sizePoints.width() * sizePoints.height()));
+    dpi = qMin(dpi, maxDpi);
+  }
+
+  return dpi;
+}
+
+void MainWindow::onPageRendered(int pageNumber, double dpi,
+                                const QImage &image) {
+  // Results from cancelled generations never arrive, so any other DPI is a
+  // preview for the current zoom
+  bool preview = dpi != pageDpi(pageNumber);
+
+  // Gray renders are always Grayscale8. A page whose colour mode flipped
+  // after the request keeps its raster in the cache but does not show it.
+  bool color = image.format() != QImage::Format_Grayscale8;
+  bool current = color == m_printSettings.pageInColor(pageNumber);
+
+  if (current) {
+    if (preview)
+      m_pendingPreviews.remove(pageNumber);
+    else
+      m_pendingPages.remove(pageNumber);
+  }
+
+  if (pageNumber >= m_canvas->pageCount())
+    return;
+
+  m_rasterCache.insert(RasterKey(m_documentId, pageNumber, dpi, color), image);
+
+  // Saves the coverage scan a render of its own
+  if (color)
+    m_inkCoverage->submit(pageNumber, image);
+
+  if (!current)
+    return;
+
+  // The page may have scrolled out of range while it was rendering
+  int sheet = m_canvas->sheetOfPage(pageNumber);
+  if (sheet < m_keepFirst || sheet > m_keepLast)
+    return;
+
+  if (preview)
+    m_canvas->setPreviewPixmap(pageNumber,
+                               uploadRaster(image, pageNumber, dpi));
+  else
+    m_canvas->setPagePixmap(pageNumber,
+                            uploadRaster(image, pageNumber, dpi));
+
+  enforceMemoryBudget();
+}
+
+void MainWindow::renderTiles(int pageNumber, const QRect &viewRect) {
+  QRect pageRect = m_canvas->pageRect(pageNumber);
+
+  QRect visible =
+      viewRect.intersected(pageRect).translated(-pageRect.topLeft());
+  if (visible.isEmpty())
+    return;
+
+  const int tileSize = PageCanvas::TileSize;
+  int lastCol = (pageRect.width() - 1) / tileSize;
+  int lastRow = (pageRect.height() - 1) / tileSize;
+
+  QRect visibleTiles(QPoint(visible.left() / tileSize,
+                            visible.top() / tileSize),
+                     QPoint(visible.right() / tileSize,
+                            visible.bottom() / tileSize));
+
+  // One ring of tiles around the viewport is kept warm for small scrolls
+  QRect keptTiles = visibleTiles.adjusted(-1, -1, 1, 1).intersected(
+      QRect(0, 0, lastCol + 1, lastRow + 1));
+  m_canvas->retainTiles(pageNumber, keptTiles);
+
+  bool colorMode = m_printSettings.pageInColor(pageNumber);
+
+  auto request = [&](const QPoint &index) {
+    if (m_canvas->hasTile(pageNumber, index))
+      return;
+
+    RasterKey key(m_documentId, pageNumber, m_dpi, colorMode, index);
+    if (m_pendingTiles.contains(key))
+      return;
+
+    QImage cached = findRaster(key);
+    if (!cached.isNull()) {
+      m_canvas->setTile(pageNumber, index,
+                        uploadRaster(cached, pageNumber, m_dpi));
+      return;
+    }
+
+    QRect tileRect = QRect(index * tileSize, QSize(tileSize, tileSize))
+                         .intersected(QRect(QPoint(0, 0), pageRect.size()));
+
+    m_pendingTiles.insert(key);
+    m_renderEngine->requestTile(pageNumber, m_dpi, !colorMode, tileRect);
+  };
+
+  for (int row = visibleTiles.top(); row <= visibleTiles.bottom(); row++)
+    for (int col = visibleTiles.left(); col <= visibleTiles.right(); col++)
+      request(QPoint(col, row));
+
+  for (int row = keptTiles.top(); row <= keptTiles.bottom(); row++)
+    for (int col = keptTiles.left(); col <= keptTiles.right(); col++)
+      request(QPoint(col, row));
+}
+
+void MainWindow::onTileRendered(int pageNumber, double dpi, const QRect &tile,
+                                const QImage &image) {
+  QPoint index(tile.x() / PageCanvas::TileSize,
+               tile.y() / PageCanvas::TileSize);
+  bool color = image.format() != QImage::Format_Grayscale8;
+  RasterKey key(m_documentId, pageNumber, dpi, color, index);
+
+  m_pendingTiles.remove(key);
+
+  if (dpi != m_dpi || pageNumber >= m_canvas->pageCount())
+    return;
+
+  m_rasterCache.insert(key, image);
+
+  // Rendered before the page's colour mode flipped
+  if (color != m_printSettings.pageInColor(pageNumber))
+    return;
+
+  int sheet = m_canvas->sheetOfPage(pageNumber);
+  if (sheet < m_keepFirst || sheet > m_keepLast)
+    return;
+
+  if (m_canvas->isTiled(pageNumber))
+    m_canvas->setTile(pageNumber, index,
+                      uploadRaster(image, pageNumber, dpi));
+}
+
+void MainWindow::scrollBy(int pixels) {
+  // updateVisiblePages() tracks the current page as the scrollbar moves
+  m_scroller->scrollBy(pixels);
+}
+
+void MainWindow::jumpToPage(int pageNumber) {
+  if (pageNumber < 0 || pageNumber >= m_document->pageCount())
+    return;
+
+  m_canvas->scrollToPage(pageNumber);
 
   m_currentPage = pageNumber;
+  m_thumbnailPanel->setCurrentPage(m_currentPage);
   updateStatusBar();
 }
 
 void MainWindow::zoomIn() {
   m_dpi *= 1.2;
-  renderAllPages();
+  m_zoomSettleTimer->start();
+  layoutPages();
 }
 
 void MainWindow::zoomOut() {
-  m_dpi *= 0.8;
+  // Inverse of zoomIn() so stepping back lands on a cached DPI
+  m_dpi /= 1.2;
   if (m_dpi < 50.0)
     m_dpi = 50.0;
 
-  renderAllPages();
+  m_zoomSettleTimer->start();
+  layoutPages();
 }
 
 void MainWindow::fitToWidth() {
-  if (!m_document.isLoaded())
+  if (!m_document->isLoaded())
     return;
 
-  QSizeF pageSize = m_document.pageSize(m_currentPage);
-  int windowWidth = m_scrollArea->viewport()->width() - 40;
+  QSizeF pageSize = m_canvas->sheetSizePoints(
+      qMax(0, m_canvas->sheetOfPage(m_currentPage)));
+  int windowWidth = m_canvas->viewport()->width() - 40;
 
   m_dpi = (windowWidth * 72) / pageSize.width();
 
-  renderAllPages();
+  layoutPages();
 }
 
 void MainWindow::fitToHeight() {
-  if (!m_document.isLoaded())
+  if (!m_document->isLoaded())
     return;
 
-  QSizeF pageSize = m_document.pageSize(m_currentPage);
-  int windowHeight = m_scrollArea->viewport()->height() - 40;
+  QSizeF pageSize = m_canvas->sheetSizePoints(
+      qMax(0, m_canvas->sheetOfPage(m_currentPage)));
+  int windowHeight = m_canvas->viewport()->height() - 40;
 
   m_dpi = (windowHeight * 72.0) / pageSize.height();
 
-  renderAllPages();
+  layoutPages();
 }
 
 int MainWindow::getCurrentVisiblePage() {
-  if (!m_document.isLoaded() || m_pageWidgets.isEmpty())
+  if (!m_document->isLoaded())
     return 0;
 
-  int scrollY = m_scrollArea->verticalScrollBar()->value();
-  int viewportCenter = scrollY + m_scrollArea->viewport()->height() / 2;
-
-  int closestPage = 0;
-  int minDistance = INT_MAX;
-
-  for (int i = 0; i < m_pageWidgets.size(); i++) {
-    PageWidget *widget = m_pageWidgets[i];
-    int widgetTop = widget->y();
-    int widgetCenter = widgetTop + widget->height() / 2;
-
-    int distance = qAbs(widgetCenter - viewportCenter);
-
-    if (distance < minDistance) {
-      minDistance = distance;
-      closestPage = i;
-    }
-  }
-
-  return closestPage;
+  return m_canvas->pageNearestCenter();
 }
 
 void MainWindow::handleNumberKey(int digit) {
@@ -404,13 +1256,13 @@ void MainWindow::handleNumberKey(int digit) {
   m_keySequenceTimer->start();
 }
 
-void MainWindow::enterCommandMode() {
+void MainWindow::enterCommandMode(const QString &prefix) {
   m_InputState = COMMAND_MODE;
   m_commandInput->clear();
-  m_commandInput->setText(":");
+  m_commandInput->setText(prefix);
   m_commandInput->setVisible(true);
   m_commandInput->setFocus();
-  m_commandInput->setCursorPosition(1);
+  m_commandInput->setCursorPosition(prefix.size());
 }
 
 void MainWindow::exitCommandMode() {
@@ -424,6 +1276,11 @@ void MainWindow::exitCommandMode() {
 void MainWindow::executeCommand(const QString &cmd) {
   QString command = cmd.trimmed();
 
+  if (command.startsWith("/")) {
+    search(command.mid(1));
+    return;
+  }
+
   if (command.startsWith(":"))
     command = command.mid(1);
 
@@ -437,9 +1294,562 @@ void MainWindow::executeCommand(const QString &cmd) {
     return;
   }
 
+  if (command == "cache") {
+    QString msg =
+        QString("Cache: %1/%2 MB, %3 pages | hits %4, misses %5 (%6%)")
+            .arg(m_rasterCache.usedBytes() / (1024.0 * 1024.0), 0, 'f', 1)
+            .arg(m_rasterCache.maxBytes() / (1024 * 1024))
+            .arg(m_rasterCache.count())
+            .arg(m_rasterCache.hits())
+            .arg(m_rasterCache.misses())
+            .arg(m_rasterCache.hitRate() * 100.0, 0, 'f', 1);
+
+    if (m_diskCache)
+      msg += QString(" | disk %1/%2 MB, hits %3, misses %4")
+                 .arg(m_diskCache->usedBytes() / (1024.0 * 1024.0), 0, 'f', 1)
+                 .arg(m_diskCache->maxBytes() / (1024 * 1024))
+                 .arg(m_diskCache->hits())
+                 .arg(m_diskCache->misses());
+
+    statusBar()->showMessage(msg, 5000);
+    return;
+  }
+
+  if (command.startsWith("search ")) {
+    search(command.mid(7));
+    return;
+  }
+
+  if (command.startsWith("set ")) {
+    setOption(command.mid(4));
+    return;
+  }
+
+  if (command == "stats") {
+    statusBar()->showMessage(statsLines().join(" | "), 8000);
+    return;
+  }
+
+  if (command == "ink") {
+    showInkCoverage();
+    return;
+  }
+
+  if (command == "blank") {
+    toggleBlankPages();
+    return;
+  }
+
+  if (command == "split" || command.startsWith("split ")) {
+    setColorSplit(command.mid(5));
+    return;
+  }
+
+  if (command == "hud") {
+    toggleHud();
+    return;
+  }
+
+  if (command == "print" || command.startsWith("print ")) {
+    printDocument(command.mid(5).trimmed());
+    return;
+  }
+
+  if (command == "trace" || command.startsWith("trace ")) {
+    toggleTrace(command.mid(5).trimmed());
+    return;
+  }
+
+  if (command.startsWith("e ") || command.startsWith("open ")) {
+    loadDocument(command.mid(command.indexOf(' ') + 1).trimmed());
+    return;
+  }
+
+  if (command == "tabclose") {
+    closeTab(m_activeTab);
+    return;
+  }
+
+  if (command == "tabnext" || command == "tabprevious") {
+    cycleTab(command == "tabnext" ? 1 : -1);
+    return;
+  }
+
+  if (command == "cancelprint") {
+    if (m_printJob)
+      m_printJob->cancel();
+    return;
+  }
+
   statusBar()->showMessage("Unknown command: " + command, 2000);
 }
 
+void MainWindow::setOption(const QString &assignment) {
+  QString name = assignment.section('=', 0, 0).trimmed();
+  QString value = assignment.section('=', 1).trimmed();
+
+  if (name == "cachemb") {
+    if (value.isEmpty()) {
+      statusBar()->showMessage(
+          QString("cachemb=%1").arg(m_memoryBudget / (1024 * 1024)), 2000);
+      return;
+    }
+
+    bool ok;
+    qint64 megabytes = value.toLongLong(&ok);
+    if (!ok || megabytes <= 0) {
+      statusBar()->showMessage("Usage: :set cachemb=<megabytes>", 2000);
+      return;
+    }
+
+    m_memoryBudget = megabytes * 1024 * 1024;
+    m_memoryTier = 0;
+    enforceMemoryBudget();
+    updateVisiblePages();
+    statusBar()->showMessage(
+        QString("Raster memory budget: %1 MB").arg(megabytes), 2000);
+    return;
+  }
+
+  if (name == "smoothscroll") {
+    if (value == "on" || value == "off")
+      m_scroller->setEnabled(value == "on");
+    else if (!value.isEmpty()) {
+      statusBar()->showMessage("Usage: :set smoothscroll=on|off", 2000);
+      return;
+    }
+    statusBar()->showMessage(QString("smoothscroll=%1")
+                                 .arg(m_scroller->isEnabled() ? "on" : "off"),
+                             2000);
+    return;
+  }
+
+  statusBar()->showMessage("Unknown option: " + name, 2000);
+}
+
+void MainWindow::printDocument(const QString &outputFile) {
+  if (!m_document->isLoaded())
+    return;
+
+  if (m_printJob) {
+    statusBar()->showMessage("A print job is already running", 2000);
+    return;
+  }
+
+  m_printJob = new PrintJob(m_document->filePath(), m_loadMode,
+                            m_printSettings, m_document->pageCount(),
+                            outputFile, this);
+
+  // Opening the printer for nothing would report a successful empty job
+  if (m_printJob->totalSheets() == 0) {
+    delete m_printJob;
+    m_printJob = nullptr;
+    statusBar()->showMessage("Nothing to print: no pages in the range", 3000);
+    return;
+  }
+
+  connect(m_printJob, &PrintJob::progress, this,
+          [this](int printed, int total) {
+            statusBar()->showMessage(
+                QString("Printing %1/%2 (:cancelprint to stop)")
+                    .arg(printed)
+                    .arg(total),
+                2000);
+          });
+
+  connect(m_printJob, &PrintJob::finished, this,
+          [this](bool success, const QString &error) {
+            statusBar()->showMessage(
+                success ? "Print job finished" : "Print failed: " + error,
+                4000);
+            m_printJob->deleteLater();
+            m_printJob = nullptr;
+          });
+
+  statusBar()->showMessage(
+      QString("Printing %1 sheets to %2")
+          .arg(m_printJob->totalSheets())
+          .arg(outputFile.isEmpty() ? "the default printer" : outputFile),
+      2000);
+
+  m_printJob->start();
+}
+
+void MainWindow::toggleTrace(const QString &outputFile) {
+  if (Trace::isEnabled()) {
+    QString path = Trace::outputPath();
+    QString error;
+    int spans = Trace::stop(&error);
+
+    if (spans < 0)
+      statusBar()->showMessage("Trace failed: " + error, 4000);
+    else
+      statusBar()->showMessage(
+          QString("Trace: %1 spans written to %2").arg(spans).arg(path), 4000);
+    return;
+  }
+
+  QString path = outputFile.isEmpty() ? "ctrlp-trace.json" : outputFile;
+  Trace::start(path);
+  statusBar()->showMessage("Tracing to " + path + " (:trace to stop)", 4000);
+}
+
+QStringList MainWindow::statsLines() const {
+  RenderEngine::Stats render = m_renderEngine->stats();
+  QStringList lines;
+
+  lines << QString("Queue: %1 waiting, %2 rendering on %3 threads")
+               .arg(render.queued)
+               .arg(render.rendering)
+               .arg(m_renderEngine->threadCount());
+
+  lines << QString("Cache: %1/%2 MB, hit rate %3%")
+               .arg(m_rasterCache.usedBytes() / (1024.0 * 1024.0), 0, 'f', 1)
+               .arg(m_rasterCache.maxBytes() / (1024 * 1024))
+               .arg(m_rasterCache.hitRate() * 100.0, 0, 'f', 1);
+
+  const char *tiers[] = {"", ", cache trimmed", ", off-screen downscaled",
+                         ", off-screen cleared"};
+  lines << QString("Memory: %1/%2 MB budget%3%4")
+               .arg((m_rasterCache.usedBytes() + m_canvas->rasterBytes()) /
+                        (1024.0 * 1024.0),
+                    0, 'f', 1)
+               .arg(m_memoryBudget / (1024 * 1024))
+               .arg(tiers[m_memoryTier])
+               .arg(m_memoryPressure ? ", system low on memory" : "");
+
+  lines << QString("Rasters: %1 MB on screen, thumbnails %2 MB, RSS %3 MB")
+               .arg(m_canvas->rasterBytes() / (1024.0 * 1024.0), 0, 'f', 1)
+               .arg(m_thumbnailPanel->cachedBytes() / (1024.0 * 1024.0), 0,
+                    'f', 1)
+               .arg(SystemMemory::residentKB() / 1024.0, 0, 'f', 1);
+
+  if (render.lastPage >= 0)
+    lines << QString("Render: %1 ms for page %2, avg %3 ms over %4")
+                 .arg(render.lastRenderMs, 0, 'f', 1)
+                 .arg(render.lastPage + 1)
+                 .arg(render.averageRenderMs, 0, 'f', 1)
+                 .arg(render.rendered);
+  else
+    lines << "Render: nothing rendered yet";
+
+  lines << QString("Documents: %1 open, %2 shown")
+               .arg(m_tabs.size())
+               .arg(m_activeTab + 1);
+
+  lines << QString("Paint: %1 ms at %2 DPI, scrolling %3 px/s")
+               .arg(m_canvas->lastPaintMs(), 0, 'f', 2)
+               .arg(m_dpi, 0, 'f', 0)
+               .arg(m_scroller->velocity(), 0, 'f', 0);
+
+  return lines;
+}
+
+void MainWindow::toggleHud() {
+  if (m_hudTimer->isActive()) {
+    m_hudTimer->stop();
+    m_canvas->setHudLines(QStringList());
+  } else {
+    m_hudTimer->start();
+    updateHud();
+  }
+}
+
+void MainWindow::updateHud() { m_canvas->setHudLines(statsLines()); }
+
+void MainWindow::search(const QString &pattern) {
+  m_searchPattern = pattern.trimmed();
+  m_searchHits.clear();
+  m_currentHit = -1;
+
+  if (m_searchPattern.isEmpty() || !m_document->isLoaded()) {
+    clearSearch();
+    return;
+  }
+
+  m_searchHits = m_textIndex->search(m_searchPattern);
+
+  // Start at the first hit on or after the current page, wrapping around
+  for (int i = 0; i < m_searchHits.size(); i++) {
+    if (m_searchHits[i].pageNumber >= m_currentPage) {
+      m_currentHit = i;
+      break;
+    }
+  }
+  if (m_currentHit < 0 && !m_searchHits.isEmpty())
+    m_currentHit = 0;
+
+  if (m_currentHit >= 0) {
+    showHit(m_currentHit);
+  } else {
+    updateSearchHighlights();
+    showSearchStatus();
+  }
+}
+
+void MainWindow::refreshSearch() {
+  if (m_searchPattern.isEmpty())
+    return;
+
+  // Hits are only ever added, so the current one keeps its place unless the
+  // first hits have only just arrived
+  bool hadHit = m_currentHit >= 0;
+  TextIndex::Hit current = hadHit ? m_searchHits[m_currentHit]
+                                  : TextIndex::Hit{-1, QRectF()};
+
+  m_searchHits = m_textIndex->search(m_searchPattern);
+
+  if (!hadHit) {
+    search(m_searchPattern);
+    return;
+  }
+
+  for (int i = 0; i < m_searchHits.size(); i++) {
+    if (m_searchHits[i].pageNumber == current.pageNumber &&
+        m_searchHits[i].rect == current.rect) {
+      m_currentHit = i;
+      break;
+    }
+  }
+
+  updateSearchHighlights();
+  showSearchStatus();
+}
+
+void MainWindow::showHit(int index) {
+  if (index < 0 || index >= m_searchHits.size())
+    return;
+
+  m_currentHit = index;
+  const TextIndex::Hit &hit = m_searchHits[index];
+
+  jumpToPage(hit.pageNumber);
+  m_canvas->scrollToPageRect(hit.pageNumber, hit.rect);
+
+  updateSearchHighlights();
+  showSearchStatus();
+}
+
+void MainWindow::stepHit(int step) {
+  if (m_searchHits.isEmpty())
+    return;
+
+  int count = m_searchHits.size();
+  showHit(((m_currentHit + step) % count + count) % count);
+}
+
+void MainWindow::clearSearch() {
+  m_searchPattern.clear();
+  m_searchHits.clear();
+  m_currentHit = -1;
+  m_searchRefreshTimer->stop();
+  updateSearchHighlights();
+}
+
+void MainWindow::updateSearchHighlights() {
+  QHash<int, QVector<QRectF>> highlights;
+  for (const TextIndex::Hit &hit : m_searchHits)
+    highlights[hit.pageNumber].append(hit.rect);
+
+  if (m_currentHit >= 0) {
+    const TextIndex::Hit &hit = m_searchHits[m_currentHit];
+    m_canvas->setHighlights(highlights, hit.pageNumber, hit.rect);
+  } else {
+    m_canvas->setHighlights(highlights);
+  }
+}
+
+void MainWindow::showSearchStatus() {
+  QString msg;
+  if (m_searchHits.isEmpty())
+    msg = QString("/%1: no matches").arg(m_searchPattern);
+  else
+    msg = QString("/%1: match %2 of %3")
+              .arg(m_searchPattern)
+              .arg(m_currentHit + 1)
+              .arg(m_searchHits.size());
+
+  if (m_textIndex->hasFailed())
+    msg += QString(" (text index failed after %1/%2 pages)")
+               .arg(m_textIndex->indexedPages())
+               .arg(m_textIndex->pageCount());
+  else if (!m_textIndex->isComplete())
+    msg += QString(" (indexed %1/%2 pages)")
+               .arg(m_textIndex->indexedPages())
+               .arg(m_textIndex->pageCount());
+
+  statusBar()->showMessage(msg, 4000);
+}
+
+void MainWindow::showInkCoverage() {
+  if (!m_document->isLoaded())
+    return;
+
+  auto format = [](const InkCoverage::Result &ink) {
+    return QString("C %1% M %2% Y %3% K %4%")
+        .arg(ink.cyan, 0, 'f', 1)
+        .arg(ink.magenta, 0, 'f', 1)
+        .arg(ink.yellow, 0, 'f', 1)
+        .arg(ink.black, 0, 'f', 1);
+  };
+
+  QString msg;
+  InkCoverage::Result ink;
+  if (m_inkCoverage->result(m_currentPage, &ink))
+    msg = QString("Page %1: %2%3")
+              .arg(m_currentPage + 1)
+              .arg(format(ink))
+              .arg(ink.blank ? " (blank)" : "");
+  else
+    msg = QString("Page %1: not measured yet").arg(m_currentPage + 1);
+
+  int scanned = m_inkCoverage->scannedPages();
+  if (scanned > 0)
+    msg += QString(" | Document: %1 over %2/%3 pages, %4 blank")
+               .arg(format(m_inkCoverage->documentResult()))
+               .arg(scanned)
+               .arg(m_inkCoverage->pageCount())
+               .arg(m_inkCoverage->blankPages().size());
+
+  statusBar()->showMessage(msg, 8000);
+}
+
+void MainWindow::toggleBlankPages() {
+  m_skipBlankPages = !m_skipBlankPages;
+  applyPageFilters();
+  updateStatusBar();
+
+  QString msg = m_skipBlankPages ? "Blank pages: skipped when printing"
+                                 : "Blank pages: printed";
+  if (m_skipBlankPages && !m_inkCoverage->isComplete())
+    msg += QString(" (%1/%2 pages checked)")
+               .arg(m_inkCoverage->scannedPages())
+               .arg(m_inkCoverage->pageCount());
+
+  statusBar()->showMessage(msg, 3000);
+}
+
+void MainWindow::setColorSplit(const QString &name) {
+  QString value = name.trimmed().toLower();
+  if (value == "off")
+    m_colorSplit = SplitOff;
+  else if (value == "page")
+    m_colorSplit = SplitByPage;
+  else if (value == "color")
+    m_colorSplit = ColorPagesOnly;
+  else if (value == "mono")
+    m_colorSplit = MonoPagesOnly;
+  else if (!value.isEmpty()) {
+    statusBar()->showMessage("Usage: :split off|page|color|mono", 2000);
+    return;
+  }
+
+  applyPageFilters();
+
+  const char *names[] = {"off", "per page", "color pages only",
+                         "mono pages only"};
+  QString msg = QString("Color split: %1 | %2 color, %3 mono")
+                    .arg(names[m_colorSplit])
+                    .arg(m_inkCoverage->colorPages().size())
+                    .arg(m_inkCoverage->monoPages().size());
+  if (!m_inkCoverage->isComplete())
+    msg += QString(" (%1/%2 pages checked)")
+               .arg(m_inkCoverage->scannedPages())
+               .arg(m_inkCoverage->pageCount());
+
+  statusBar()->showMessage(msg, 4000);
+}
+
+void MainWindow::applyPageFilters() {
+  auto toSet = [](const QList<int> &pages) {
+    return QSet<int>(pages.begin(), pages.end());
+  };
+
+  QSet<int> excluded;
+  if (m_skipBlankPages)
+    excluded = toSet(m_inkCoverage->blankPages());
+
+  // Pages not measured yet count as colour, the safe way to print them
+  QSet<int> grayscale;
+  QSet<int> mono = toSet(m_inkCoverage->monoPages());
+  switch (m_colorSplit) {
+  case SplitOff:
+    break;
+  case SplitByPage:
+    grayscale = mono;
+    break;
+  case ColorPagesOnly:
+    excluded.unite(mono);
+    break;
+  case MonoPagesOnly:
+    grayscale = mono;
+    for (int page = 0; page < m_document->pageCount(); page++) {
+      if (!mono.contains(page))
+        excluded.insert(page);
+    }
+    break;
+  }
+
+  bool rangeChanged = excluded != m_printSettings.excludedPages;
+  QSet<int> flipped = grayscale - m_printSettings.grayscalePages;
+  flipped |= m_printSettings.grayscalePages - grayscale;
+  if (!rangeChanged && flipped.isEmpty())
+    return;
+
+  m_printSettings.excludedPages = excluded;
+  m_printSettings.grayscalePages = grayscale;
+
+  // Imposed previews show the print range, so the sheets change with it
+  if (rangeChanged && m_canvas->isImposed()) {
+    updateImposition();
+    layoutPages();
+    return;
+  }
+
+  // Without colour printing every page is gray either way
+  if (!m_printSettings.colorMode || flipped.isEmpty())
+    return;
+
+  swapColorMode(flipped);
+}
+
+void MainWindow::swapColorMode(const QSet<int> &pages) {
+  // Renders still queued in the old mode are cached when they arrive but
+  // not shown. Pages with nothing cached in the new mode keep their old
+  // raster as a stand-in until it is rendered.
+  for (int page : pages) {
+    m_pendingPages.remove(page);
+    m_pendingPreviews.remove(page);
+    if (!m_canvas->hasAnyPixmap(page))
+      continue;
+
+    m_canvas->invalidatePage(page);
+
+    bool color = m_printSettings.pageInColor(page);
+    double dpi = pageDpi(page);
+    QImage image = m_canvas->isTiled(page)
+                       ? QImage()
+                       : findRaster(RasterKey(m_documentId, page, dpi, color));
+    if (!image.isNull()) {
+      m_canvas->setPagePixmap(page, uploadRaster(image, page, dpi));
+      continue;
+    }
+
+    dpi = previewDpi(page);
+    image = findRaster(RasterKey(m_documentId, page, dpi, color));
+    if (!image.isNull())
+      m_canvas->setPreviewPixmap(page, uploadRaster(image, page, dpi));
+  }
+  for (auto it = m_pendingTiles.begin(); it != m_pendingTiles.end();) {
+    if (pages.contains(it->pageNumber))
+      it = m_pendingTiles.erase(it);
+    else
+      ++it;
+  }
+
+  updateVisiblePages();
+}
+
 void MainWindow::resetKeySequence() {
   m_InputState = NORMAL;
   m_numberBuffer.clear();
@@ -460,8 +1870,13 @@ void MainWindow::cycleMargniPreset() {
   else
     m_printSettings.margins = PrintSettings::marginPresetNone();
 
-  for (PageWidget *widget : m_pageWidgets)
-    widget->update();
+  // Imposed cells are cut from the printable area, so they move with it
+  if (m_canvas->isImposed()) {
+    updateImposition();
+    layoutPages();
+  } else {
+    m_canvas->viewport()->update();
+  }
 
   statusBar()->showMessage(
       QString("Margins: %1").arg(m_printSettings.marginPresetName()), 2000);
@@ -480,8 +1895,7 @@ void MainWindow::cycleDuplexMode() {
     break;
   }
 
-  for (PageWidget *widget : m_pageWidgets)
-    widget->update();
+  m_canvas->viewport()->update();
 
   statusBar()->showMessage(
       QString("Duplex: %1").arg(m_printSettings.duplexModeName()), 2000);
@@ -490,7 +1904,20 @@ void MainWindow::cycleDuplexMode() {
 void MainWindow::toggleColorMode() {
   m_printSettings.colorMode = !m_printSettings.colorMode;
 
-  renderAllPages();
+  // Only sheets in the keep band hold rasters, and pages already printed
+  // gray look the same either way. Cached colour rasters are converted
+  // instead of rendered again, and are still there when switching back.
+  if (m_document->isLoaded()) {
+    QSet<int> flipped;
+    for (int sheet = qMax(0, m_keepFirst);
+         sheet <= qMin(m_canvas->sheetCount() - 1, m_keepLast); sheet++) {
+      for (int page : m_canvas->pagesOnSheet(sheet)) {
+        if (!m_printSettings.grayscalePages.contains(page))
+          flipped.insert(page);
+      }
+    }
+    swapColorMode(flipped);
+  }
 
   statusBar()->showMessage(
       m_printSettings.colorMode ? "Color: On" : "Color: Off (Grayscale)", 2000);
@@ -510,9 +1937,39 @@ void MainWindow::cycleScaleMode() {
     break;
   }
 
-  for (PageWidget *widget : m_pageWidgets)
-    widget->update();
+  m_canvas->viewport()->update();
 
   statusBar()->showMessage(
       QString("Scale: %1").arg(m_printSettings.scaleModeName()), 2000);
 }
+
+void MainWindow::cyclePageLayout() {
+  switch (m_printSettings.pageLayout) {
+  case PrintSettings::OneUp:
+    m_printSettings.pageLayout = PrintSettings::TwoUp;
+    break;
+  case PrintSettings::TwoUp:
+    m_printSettings.pageLayout = PrintSettings::FourUp;
+    break;
+  case PrintSettings::FourUp:
+    m_printSettings.pageLayout = PrintSettings::Booklet;
+    break;
+  case PrintSettings::Booklet:
+    m_printSettings.pageLayout = PrintSettings::OneUp;
+    break;
+  }
+
+  int page = m_currentPage;
+  updateImposition();
+  layoutPages();
+  jumpToPage(page);
+
+  statusBar()->showMessage(
+      QString("Layout: %1").arg(m_printSettings.pageLayoutName()), 2000);
+}
+
+void MainWindow::toggleThumbnails() {
+  m_thumbnailPanel->setVisible(!m_thumbnailPanel->isVisible());
+  if (m_thumbnailPanel->isVisible())
+    m_thumbnailPanel->setCurrentPage(m_currentPage);
+}
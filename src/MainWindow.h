@@ -1,24 +1,45 @@
 #ifndef MAINWINDOW_H_
 #define MAINWINDOW_H_
 
+#include "DiskCache.h"
 #include "Document.h"
-#include "PageWidget.h"
+#include "DocumentWatcher.h"
+#include "InkCoverage.h"
+#include "PageCanvas.h"
+#include "PrintJob.h"
 #include "PrintSettings.h"
+#include "RasterCache.h"
+#include "RenderEngine.h"
+#include "TextIndex.h"
+#include "ThumbnailPanel.h"
 #include <QColor>
 #include <QKeyEvent>
 #include <QLabel>
 #include <QLineEdit>
 #include <QMainWindow>
-#include <QScrollArea>
+#include <QPoint>
+#include <QSet>
+#include <QStringList>
 #include <QTimer>
-#include <QVBoxLayout>
+#include <memory>
+#include <vector>
+
+class QTabBar;
+class SmoothScroller;
 
 class MainWindow : public QMainWindow {
   Q_OBJECT
 
 public:
   MainWindow(QWidget *parent = nullptr);
+  ~MainWindow();
+  // Opens the file in a new tab, or in the current one while it is empty
   bool loadDocument(const QString &filePath);
+  void reloadDocument();
+  // MemoryMap applies to documents opened afterwards, which are then not
+  // watched for rewrites
+  void setLoadMode(Document::LoadMode mode) { m_loadMode = mode; }
+  void enableDiskCache(const QString &directory, qint64 maxBytes);
   const PrintSettings &printSettings() const { return m_printSettings; }
 
 protected:
@@ -27,7 +48,23 @@ protected:
 private:
   void setupUI();
   void updateStatusBar();
-  void renderAllPages();
+  void clearPages();
+  void layoutPages();
+  void updateImposition();
+  void updateVisiblePages();
+  void renderPage(int pageNumber);
+  void renderPreview(int pageNumber);
+  QImage findRaster(const RasterKey &key);
+  QImage probeRaster(const RasterKey &key, bool *inMemory);
+  double pageDpi(int pageNumber) const;
+  double previewDpi(int pageNumber) const;
+  void renderTiles(int pageNumber, const QRect &viewRect);
+  void onPageRendered(int pageNumber, double dpi, const QImage &image);
+  void onTileRendered(int pageNumber, double dpi, const QRect &tile,
+                      const QImage &image);
+  void onPagesChanged(int documentId, const QList<int> &pages);
+  void enforceMemoryBudget();
+  void checkMemoryPressure();
 
   void scrollBy(int pixels);
   void jumpToPage(int pageNumber);
@@ -38,35 +75,144 @@ private:
   int getCurrentVisiblePage();
 
   void handleNumberKey(int digit);
-  void enterCommandMode();
+  void enterCommandMode(const QString &prefix = ":");
   void exitCommandMode();
   void executeCommand(const QString &cmd);
+  void setOption(const QString &assignment);
+  void printDocument(const QString &outputFile);
+  void toggleTrace(const QString &outputFile);
+
+  void search(const QString &pattern);
+  void refreshSearch();
+  void showHit(int index);
+  void stepHit(int step);
+  void clearSearch();
+  void updateSearchHighlights();
+  void showSearchStatus();
+  void showInkCoverage();
+  void toggleBlankPages();
+  void setColorSplit(const QString &name);
+  void applyPageFilters();
+  // Shows the pages in their new colour mode without re-rendering those
+  // whose raster in that mode is cached or converts from one
+  void swapColorMode(const QSet<int> &pages);
+  QStringList statsLines() const;
+  void toggleHud();
+  void updateHud();
   void resetKeySequence();
 
   void cycleMargniPreset();
   void cycleDuplexMode();
   void toggleColorMode();
   void cycleScaleMode();
+  void cyclePageLayout();
+  void toggleThumbnails();
+
+  struct DocumentTab;
+  DocumentTab *createTab();
+  DocumentTab *activeTab() const;
+  DocumentTab *findTab(int documentId) const;
+  void saveTabState();
+  void activateTab(int index);
+  void closeTab(int index);
+  void cycleTab(int step);
 
   enum InputState { NORMAL, AWAITING_G, COMMAND_MODE };
 
-  Document m_document;
+  // How detected colour and mono pages are printed: each in its own mode,
+  // or only one kind, for sending the two halves to different printers
+  enum ColorSplit { SplitOff, SplitByPage, ColorPagesOnly, MonoPagesOnly };
+
+  // One open document. Its objects run in the background and share the
+  // render pool and raster cache with every other tab. The view state is
+  // copied into the MainWindow members below while the tab is shown and
+  // saved back when another tab takes over.
+  struct DocumentTab {
+    int id;
+    std::unique_ptr<Document> document;
+    TextIndex *textIndex;
+    InkCoverage *inkCoverage;
+    DocumentWatcher *watcher;
+    QByteArray contentHash;
+    // The file changed while another tab was shown
+    bool reloadPending;
+
+    PrintSettings printSettings;
+    int currentPage;
+    double dpi;
+    QPoint scroll;
+    QString searchPattern;
+    QVector<TextIndex::Hit> searchHits;
+    int currentHit;
+    bool skipBlankPages;
+    ColorSplit colorSplit;
+  };
+
+  std::vector<std::unique_ptr<DocumentTab>> m_tabs;
+  int m_activeTab;
+  int m_nextDocumentId;
+  QTabBar *m_tabBar;
+
+  // The active tab's document and background objects
+  int m_documentId;
+  Document *m_document;
+  // Only read files are watched. A rebuild truncates and rewrites the file
+  // in place, and any read of a mapping past the new end would raise SIGBUS
+  // in whichever thread touched it.
+  Document::LoadMode m_loadMode;
   int m_currentPage;
   double m_dpi;
 
   int m_pageGap;
   int m_scrollAmount;
+  int m_prefetchPages;
+  int m_evictDistance;
+  qint64 m_tiledPixelThreshold;
+  double m_previewDivisor;
   bool m_showPageBoundaries;
   QColor m_pageBoundaryColor;
 
-  QScrollArea *m_scrollArea;
-  QWidget *m_contentWidget;
-  QVBoxLayout *m_contentLayout;
-  QList<PageWidget *> m_pageWidgets;
+  PageCanvas *m_canvas;
+  SmoothScroller *m_scroller;
+  ThumbnailPanel *m_thumbnailPanel;
+
+  RenderEngine *m_renderEngine;
+  RasterCache m_rasterCache;
+  std::shared_ptr<DiskCache> m_diskCache;
+  QByteArray m_contentHash;
+  QSet<int> m_pendingPages;
+  QSet<int> m_pendingPreviews;
+  QSet<RasterKey> m_pendingTiles;
+  int m_keepFirst;
+  int m_keepLast;
+
+  // Ceiling for page rasters in the cache and on the canvas together.
+  // Past it, rasters go in tiers: off-screen cache entries, then the
+  // off-screen pages kept on the canvas are downscaled, then cleared.
+  // System memory pressure lowers the ceiling and stops prefetching.
+  qint64 m_memoryBudget;
+  bool m_memoryPressure;
+  int m_memoryTier;
+  QTimer *m_memoryTimer;
+
+  PrintJob *m_printJob;
+  DocumentWatcher *m_watcher;
+
+  TextIndex *m_textIndex;
+  QString m_searchPattern;
+  QVector<TextIndex::Hit> m_searchHits;
+  int m_currentHit;
+  QTimer *m_searchRefreshTimer;
+
+  InkCoverage *m_inkCoverage;
+  bool m_skipBlankPages;
+  ColorSplit m_colorSplit;
 
   InputState m_InputState;
   QString m_numberBuffer;
   QTimer *m_keySequenceTimer;
+  QTimer *m_zoomSettleTimer;
+  QTimer *m_hudTimer;
   QLineEdit *m_commandInput;
 
   PrintSettings m_printSettings;
@@ -0,0 +1,756 @@
+#include "PageCanvas.h"
+#include "Document.h"
+#include "PrintSettings.h"
+#include "Trace.h"
+#include <QElapsedTimer>
+#include <QFont>
+#include <QFontMetrics>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QPen>
+#include <QResizeEvent>
+#include <QScrollBar>
+#include <algorithm>
+#include <qnamespace.h>
+
+PageCanvas::PageCanvas(QWidget *parent)
+    : QAbstractScrollArea(parent), m_document(nullptr),
+      m_printSettings(nullptr), m_dpi(150.0), m_pageGap(20),
+      m_contentMargin(20), m_showPageBoundaries(true),
+      m_pageBoundaryColor(68, 68, 68), m_tiledPixelThreshold(4096 * 4096),
+      m_maxSheetWidth(0.0), m_currentHighlightPage(-1), m_lastPaintMs(0.0) {
+  setStyleSheet("background-color: black; border: none;");
+  setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+  setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+}
+
+void PageCanvas::setDocument(const Document *document) {
+  m_document = document;
+  m_highlights.clear();
+  m_currentHighlightPage = -1;
+  m_sheets.clear();
+  m_sheetOffsets.clear();
+  m_pageSheets.clear();
+  m_rasters.clear();
+  updateScrollBars();
+  verticalScrollBar()->setValue(0);
+  viewport()->update();
+}
+
+void PageCanvas::setPrintSettings(const PrintSettings *settings) {
+  m_printSettings = settings;
+  viewport()->update();
+}
+
+void PageCanvas::setDPI(double dpi) {
+  m_dpi = dpi;
+
+  // Rasters from the previous zoom stay on screen, stretched, until the
+  // caller replaces them
+  for (PageRaster &raster : m_rasters) {
+    raster.isPreview = true;
+    raster.tiles.clear();
+  }
+
+  updateScrollBars();
+  viewport()->update();
+}
+
+double PageCanvas::dpi() const { return m_dpi; }
+
+void PageCanvas::setPageGap(int gap) {
+  m_pageGap = gap;
+  updateScrollBars();
+  viewport()->update();
+}
+
+void PageCanvas::setPageBoundaries(bool show, const QColor &color) {
+  m_showPageBoundaries = show;
+  m_pageBoundaryColor = color;
+  updateScrollBars();
+  viewport()->update();
+}
+
+void PageCanvas::setTiledPixelThreshold(qint64 pixels) {
+  m_tiledPixelThreshold = pixels;
+}
+
+qint64 PageCanvas::tiledPixelThreshold() const { return m_tiledPixelThreshold; }
+
+void PageCanvas::setImposition(const QVector<SheetLayout> &sheets) {
+  m_sheets = sheets;
+  m_sheetOffsets.clear();
+  m_pageSheets.clear();
+  m_maxSheetWidth = 0.0;
+
+  // Imposed sheets get the same cumulative offsets as the document's page
+  // geometry, built once per layout change
+  if (!m_sheets.isEmpty()) {
+    m_sheetOffsets.reserve(m_sheets.size() + 1);
+    m_pageSheets.fill(-1, pageCount());
+
+    double offset = 0.0;
+    for (int i = 0; i < m_sheets.size(); i++) {
+      m_sheetOffsets.append(offset);
+      offset += m_sheets[i].paperPoints.height();
+      m_maxSheetWidth = qMax(m_maxSheetWidth, m_sheets[i].paperPoints.width());
+
+      for (const PagePlacement &placement : m_sheets[i].placements)
+        m_pageSheets[placement.pageNumber] = i;
+    }
+    m_sheetOffsets.append(offset);
+  }
+
+  // Rasters sized for the previous layout stay on screen, stretched, until
+  // the caller replaces them
+  for (PageRaster &raster : m_rasters) {
+    raster.isPreview = true;
+    raster.tiles.clear();
+  }
+
+  updateScrollBars();
+  viewport()->update();
+}
+
+bool PageCanvas::isImposed() const { return !m_sheets.isEmpty(); }
+
+int PageCanvas::sheetCount() const {
+  return isImposed() ? m_sheets.size() : pageCount();
+}
+
+QSizeF PageCanvas::sheetSizePoints(int sheet) const {
+  return isImposed() ? m_sheets[sheet].paperPoints
+                     : m_document->pageSize(sheet);
+}
+
+double PageCanvas::sheetOffset(int sheet) const {
+  return isImposed() ? m_sheetOffsets[sheet] : m_document->pageOffset(sheet);
+}
+
+QSize PageCanvas::sheetPixelSize(int sheet) const {
+  // Heights come from rounded cumulative offsets so that sheet tops can be
+  // computed directly without summing every sheet above
+  double scale = m_dpi / 72.0;
+  int top = qRound(sheetOffset(sheet) * scale);
+  int bottom = qRound(sheetOffset(sheet + 1) * scale);
+
+  return QSize(qRound(sheetSizePoints(sheet).width() * scale), bottom - top);
+}
+
+QRect PageCanvas::sheetRect(int sheet) const {
+  QSize size = sheetPixelSize(sheet);
+  int width = qMax(contentWidth(), viewport()->width());
+
+  return QRect(QPoint((width - size.width()) / 2, sheetTop(sheet)), size);
+}
+
+int PageCanvas::sheetPitch(int sheet) const {
+  return sheetPixelSize(sheet).height() + sheetStride();
+}
+
+int PageCanvas::sheetStride() const {
+  return 2 * m_pageGap + (m_showPageBoundaries ? 1 : 0);
+}
+
+int PageCanvas::sheetTop(int sheet) const {
+  return m_contentMargin + qRound(sheetOffset(sheet) * m_dpi / 72.0) +
+         sheet * sheetStride();
+}
+
+int PageCanvas::sheetAt(int y) const {
+  // Last sheet whose top is at or above y
+  int low = 0;
+  int high = sheetCount() - 1;
+
+  while (low < high) {
+    int mid = low + (high - low + 1) / 2;
+    if (sheetTop(mid) <= y)
+      low = mid;
+    else
+      high = mid - 1;
+  }
+
+  return low;
+}
+
+int PageCanvas::firstVisibleSheet() const {
+  if (sheetCount() == 0)
+    return -1;
+
+  int viewTop = verticalScrollBar()->value();
+  int sheet = sheetAt(viewTop);
+
+  // The top of the view may sit in the gap below a sheet
+  if (sheetRect(sheet).bottom() < viewTop && sheet < sheetCount() - 1)
+    sheet++;
+
+  return sheet;
+}
+
+int PageCanvas::lastVisibleSheet() const {
+  if (sheetCount() == 0)
+    return -1;
+
+  int viewBottom = verticalScrollBar()->value() + viewport()->height();
+  return qMax(firstVisibleSheet(), sheetAt(viewBottom));
+}
+
+int PageCanvas::sheetOfPage(int pageNumber) const {
+  if (pageNumber < 0 || pageNumber >= pageCount())
+    return -1;
+  return isImposed() ? m_pageSheets[pageNumber] : pageNumber;
+}
+
+QVector<int> PageCanvas::pagesOnSheet(int sheet) const {
+  if (!isImposed())
+    return {sheet};
+
+  QVector<int> pages;
+  for (const PagePlacement &placement : m_sheets[sheet].placements)
+    pages.append(placement.pageNumber);
+  return pages;
+}
+
+const PagePlacement *PageCanvas::placementOf(int pageNumber) const {
+  int sheet = sheetOfPage(pageNumber);
+  if (!isImposed() || sheet < 0)
+    return nullptr;
+
+  for (const PagePlacement &placement : m_sheets[sheet].placements) {
+    if (placement.pageNumber == pageNumber)
+      return &placement;
+  }
+  return nullptr;
+}
+
+QRect PageCanvas::placementRect(const QRectF &points) const {
+  double scale = m_dpi / 72.0;
+  return QRectF(points.topLeft() * scale, points.size() * scale).toRect();
+}
+
+int PageCanvas::pageCount() const {
+  return m_document ? m_document->pageCount() : 0;
+}
+
+QSize PageCanvas::pagePixelSize(int pageNumber) const {
+  if (!isImposed())
+    return sheetPixelSize(pageNumber);
+  return pageRect(pageNumber).size();
+}
+
+QRect PageCanvas::pageRect(int pageNumber) const {
+  if (!isImposed())
+    return sheetRect(pageNumber);
+
+  const PagePlacement *placement = placementOf(pageNumber);
+  if (!placement)
+    return QRect();
+
+  return placementRect(placement->rect)
+      .translated(sheetRect(sheetOfPage(pageNumber)).topLeft());
+}
+
+double PageCanvas::pageScale(int pageNumber) const {
+  const PagePlacement *placement = placementOf(pageNumber);
+  if (!placement)
+    return 1.0;
+
+  QSizeF sizePoints = m_document->pageSize(pageNumber);
+  if (sizePoints.isEmpty())
+    return 1.0;
+  return placement->rect.width() / sizePoints.width();
+}
+
+QRect PageCanvas::viewRect() const {
+  return QRect(horizontalScrollBar()->value(), verticalScrollBar()->value(),
+               viewport()->width(), viewport()->height());
+}
+
+int PageCanvas::pageNearestCenter() const {
+  if (sheetCount() == 0)
+    return 0;
+
+  int viewportCenter = verticalScrollBar()->value() + viewport()->height() / 2;
+
+  // The closest sheet center is either the sheet under the viewport center
+  // or the one after it, when the center falls in the gap below a sheet
+  int sheet = sheetAt(viewportCenter);
+  if (sheet + 1 < sheetCount()) {
+    int center = sheetRect(sheet).center().y();
+    int nextCenter = sheetRect(sheet + 1).center().y();
+
+    if (qAbs(nextCenter - viewportCenter) < qAbs(center - viewportCenter))
+      sheet++;
+  }
+
+  // Imposed sheets report their lowest page; blank booklet sides have none
+  QVector<int> pages = pagesOnSheet(sheet);
+  if (pages.isEmpty())
+    return -1;
+  return *std::min_element(pages.constBegin(), pages.constEnd());
+}
+
+bool PageCanvas::isTiled(int pageNumber) const {
+  // Imposed cells are never larger than a sheet
+  if (isImposed())
+    return false;
+
+  QSize size = pagePixelSize(pageNumber);
+  return qint64(size.width()) * size.height() > m_tiledPixelThreshold;
+}
+
+void PageCanvas::scrollToPage(int pageNumber) {
+  int sheet = sheetOfPage(pageNumber);
+  if (sheet < 0)
+    return;
+
+  verticalScrollBar()->setValue(sheetTop(sheet));
+}
+
+void PageCanvas::scrollToPageRect(int pageNumber, const QRectF &rect) {
+  QRect page = pageRect(pageNumber);
+  QSizeF sizePoints = m_document->pageSize(pageNumber);
+  if (page.isEmpty() || sizePoints.isEmpty())
+    return;
+
+  double scale = page.height() / sizePoints.height();
+  int center = page.top() + qRound(rect.center().y() * scale);
+  verticalScrollBar()->setValue(center - viewport()->height() / 2);
+}
+
+void PageCanvas::setPagePixmap(int pageNumber, const QPixmap &pixmap) {
+  PageRaster &raster = m_rasters[pageNumber];
+  raster.pixmap = pixmap;
+  raster.isPreview = false;
+  updateContentRect(pageRect(pageNumber));
+}
+
+void PageCanvas::clearPage(int pageNumber) {
+  if (m_rasters.remove(pageNumber))
+    updateContentRect(pageRect(pageNumber));
+}
+
+void PageCanvas::clearAllPages() {
+  m_rasters.clear();
+  viewport()->update();
+}
+
+void PageCanvas::invalidatePage(int pageNumber) {
+  auto raster = m_rasters.find(pageNumber);
+  if (raster == m_rasters.end())
+    return;
+
+  raster->isPreview = true;
+  raster->tiles.clear();
+}
+
+void PageCanvas::documentReloaded() {
+  int count = pageCount();
+  for (auto it = m_rasters.begin(); it != m_rasters.end();) {
+    if (it.key() >= count)
+      it = m_rasters.erase(it);
+    else
+      ++it;
+  }
+
+  int scroll = verticalScrollBar()->value();
+  updateScrollBars();
+  verticalScrollBar()->setValue(scroll);
+  viewport()->update();
+}
+
+bool PageCanvas::hasPagePixmap(int pageNumber) const {
+  auto it = m_rasters.constFind(pageNumber);
+  return it != m_rasters.constEnd() && !it->pixmap.isNull() && !it->isPreview;
+}
+
+void PageCanvas::setPreviewPixmap(int pageNumber, const QPixmap &pixmap) {
+  if (hasPagePixmap(pageNumber))
+    return;
+
+  PageRaster &raster = m_rasters[pageNumber];
+  raster.pixmap = pixmap;
+  raster.isPreview = true;
+  updateContentRect(pageRect(pageNumber));
+}
+
+bool PageCanvas::hasAnyPixmap(int pageNumber) const {
+  auto it = m_rasters.constFind(pageNumber);
+  return it != m_rasters.constEnd() && !it->pixmap.isNull();
+}
+
+void PageCanvas::setTile(int pageNumber, const QPoint &index,
+                         const QPixmap &pixmap) {
+  m_rasters[pageNumber].tiles.insert(index, pixmap);
+
+  QPoint origin = pageRect(pageNumber).topLeft() + index * TileSize;
+  updateContentRect(QRect(origin, QSize(TileSize, TileSize)));
+}
+
+bool PageCanvas::hasTile(int pageNumber, const QPoint &index) const {
+  auto it = m_rasters.constFind(pageNumber);
+  return it != m_rasters.constEnd() && it->tiles.contains(index);
+}
+
+void PageCanvas::retainTiles(int pageNumber, const QRect &tileRange) {
+  auto raster = m_rasters.find(pageNumber);
+  if (raster == m_rasters.end())
+    return;
+
+  QHash<QPoint, QPixmap> &tiles = raster->tiles;
+  for (auto it = tiles.begin(); it != tiles.end();) {
+    if (tileRange.contains(it.key()))
+      ++it;
+    else
+      it = tiles.erase(it);
+  }
+}
+
+void PageCanvas::paintEvent(QPaintEvent *event) {
+  TraceSpan span("paint");
+  QElapsedTimer timer;
+  timer.start();
+
+  QPainter painter(viewport());
+  painter.fillRect(event->rect(), Qt::black);
+
+  paintSheets(&painter, event->rect());
+
+  if (m_hudLines.isEmpty()) {
+    m_lastPaintMs = timer.nsecsElapsed() / 1e6;
+    return;
+  }
+
+  drawHud(&painter);
+
+  // Overlay refreshes would otherwise report their own tiny frames
+  if (!hudRect().contains(event->rect()))
+    m_lastPaintMs = timer.nsecsElapsed() / 1e6;
+}
+
+void PageCanvas::paintSheets(QPainter *painter, const QRect &dirty) {
+  if (sheetCount() == 0)
+    return;
+
+  QPoint offset(horizontalScrollBar()->value(), verticalScrollBar()->value());
+  QRect exposed = dirty.translated(offset);
+
+  int first = sheetAt(exposed.top());
+  int last = sheetAt(exposed.bottom());
+
+  for (int i = first; i <= last; i++) {
+    QRect rect = sheetRect(i);
+
+    if (rect.intersects(exposed)) {
+      painter->save();
+      painter->translate(rect.topLeft() - offset);
+      painter->setClipRect(QRect(QPoint(0, 0), rect.size()));
+      paintSheet(painter, i,
+                 exposed.intersected(rect).translated(-rect.topLeft()));
+      painter->restore();
+    }
+
+    if (m_showPageBoundaries && i < sheetCount() - 1) {
+      QRect separator(rect.left(), rect.bottom() + 1 + m_pageGap, rect.width(),
+                      1);
+      painter->fillRect(separator.translated(-offset), m_pageBoundaryColor);
+    }
+  }
+}
+
+void PageCanvas::paintSheet(QPainter *painter, int sheet,
+                            const QRect &exposed) {
+  QSize sheetSize = sheetPixelSize(sheet);
+
+  if (!isImposed()) {
+    paintPage(painter, sheet, sheetSize, exposed);
+  } else {
+    // Blank paper with every page painted into its cell
+    painter->fillRect(exposed, Qt::white);
+
+    for (const PagePlacement &placement : m_sheets[sheet].placements) {
+      QRect cell = placementRect(placement.rect);
+      QRect visible =
+          exposed.intersected(cell).intersected(placementRect(placement.clip));
+      if (visible.isEmpty())
+        continue;
+
+      painter->save();
+      painter->setClipRect(visible, Qt::IntersectClip);
+      painter->translate(cell.topLeft());
+      paintPage(painter, placement.pageNumber, cell.size(),
+                visible.translated(-cell.topLeft()));
+      painter->restore();
+    }
+  }
+
+  if (m_printSettings) {
+    drawMargins(painter, sheetSize);
+    drawDuplexIndicator(painter, sheet, sheetSize);
+  }
+}
+
+void PageCanvas::paintPage(QPainter *painter, int pageNumber,
+                           const QSize &pageSize, const QRect &exposed) {
+  auto raster = m_rasters.constFind(pageNumber);
+
+  // Pages outside the render window are placeholders until their raster
+  // arrives
+  if (raster == m_rasters.constEnd() || raster->pixmap.isNull()) {
+    painter->fillRect(exposed, QColor(34, 34, 34));
+  } else if (qAbs(raster->pixmap.width() - pageSize.width()) <= 1 &&
+             qAbs(raster->pixmap.height() - pageSize.height()) <= 1) {
+    painter->drawPixmap(0, 0, raster->pixmap);
+  } else {
+    // Stand-in raster from another DPI, stretched over the exposed area only
+    const QPixmap &pixmap = raster->pixmap;
+    double sx = double(pixmap.width()) / pageSize.width();
+    double sy = double(pixmap.height()) / pageSize.height();
+    QRectF source(exposed.x() * sx, exposed.y() * sy, exposed.width() * sx,
+                  exposed.height() * sy);
+
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    painter->drawPixmap(QRectF(exposed), pixmap, source);
+  }
+
+  if (raster != m_rasters.constEnd() && !raster->tiles.isEmpty()) {
+    int firstCol = exposed.left() / TileSize;
+    int lastCol = exposed.right() / TileSize;
+    int firstRow = exposed.top() / TileSize;
+    int lastRow = exposed.bottom() / TileSize;
+
+    for (int row = firstRow; row <= lastRow; row++) {
+      for (int col = firstCol; col <= lastCol; col++) {
+        auto it = raster->tiles.constFind(QPoint(col, row));
+        if (it != raster->tiles.constEnd())
+          painter->drawPixmap(QPoint(col * TileSize, row * TileSize),
+                              it.value());
+      }
+    }
+  }
+
+  if (!m_highlights.isEmpty())
+    drawHighlights(painter, pageNumber, pageSize);
+}
+
+void PageCanvas::setHighlights(const QHash<int, QVector<QRectF>> &highlights,
+                               int currentPage, const QRectF &current) {
+  m_highlights = highlights;
+  m_currentHighlightPage = currentPage;
+  m_currentHighlight = current;
+  viewport()->update();
+}
+
+void PageCanvas::drawHighlights(QPainter *painter, int pageNumber,
+                                const QSize &pageSize) {
+  auto it = m_highlights.constFind(pageNumber);
+  if (it == m_highlights.constEnd())
+    return;
+
+  QSizeF sizePoints = m_document->pageSize(pageNumber);
+  if (sizePoints.isEmpty())
+    return;
+
+  double sx = pageSize.width() / sizePoints.width();
+  double sy = pageSize.height() / sizePoints.height();
+
+  for (const QRectF &rect : it.value()) {
+    bool current =
+        pageNumber == m_currentHighlightPage && rect == m_currentHighlight;
+    QRectF scaled(rect.x() * sx, rect.y() * sy, rect.width() * sx,
+                  rect.height() * sy);
+    painter->fillRect(scaled, current ? QColor(255, 120, 0, 140)
+                                      : QColor(255, 230, 0, 90));
+  }
+}
+
+void PageCanvas::downscalePage(int pageNumber, double divisor) {
+  auto raster = m_rasters.find(pageNumber);
+  if (raster == m_rasters.end() || raster->pixmap.isNull())
+    return;
+
+  QSize size = pagePixelSize(pageNumber) / divisor;
+  if (size.isEmpty() || raster->pixmap.width() <= size.width())
+    return;
+
+  raster->pixmap = raster->pixmap.scaled(size, Qt::IgnoreAspectRatio,
+                                         Qt::SmoothTransformation);
+  raster->isPreview = true;
+  raster->tiles.clear();
+  updateContentRect(pageRect(pageNumber));
+}
+
+QList<int> PageCanvas::rasterPages() const { return m_rasters.keys(); }
+
+qint64 PageCanvas::rasterBytes() const {
+  qint64 bytes = 0;
+  for (const PageRaster &raster : m_rasters) {
+    bytes += qint64(raster.pixmap.width()) * raster.pixmap.height() *
+             raster.pixmap.depth() / 8;
+    for (const QPixmap &tile : raster.tiles)
+      bytes += qint64(tile.width()) * tile.height() * tile.depth() / 8;
+  }
+  return bytes;
+}
+
+double PageCanvas::lastPaintMs() const { return m_lastPaintMs; }
+
+void PageCanvas::setHudLines(const QStringList &lines) {
+  // Repaint the old and new overlay area only
+  QRect oldRect = hudRect();
+  m_hudLines = lines;
+  viewport()->update(oldRect.united(hudRect()));
+}
+
+QRect PageCanvas::hudRect() const {
+  if (m_hudLines.isEmpty())
+    return QRect();
+
+  QFontMetrics metrics(font());
+  int width = 0;
+  for (const QString &line : m_hudLines)
+    width = qMax(width, metrics.horizontalAdvance(line));
+
+  return QRect(10, 10, width + 20, m_hudLines.size() * metrics.height() + 16);
+}
+
+void PageCanvas::drawHud(QPainter *painter) {
+  QRect rect = hudRect();
+  painter->fillRect(rect, QColor(0, 0, 0, 180));
+
+  QFontMetrics metrics(font());
+  painter->setFont(font());
+  painter->setPen(Qt::white);
+
+  int y = rect.top() + 8 + metrics.ascent();
+  for (const QString &line : m_hudLines) {
+    painter->drawText(rect.left() + 10, y, line);
+    y += metrics.height();
+  }
+}
+
+void PageCanvas::resizeEvent(QResizeEvent *event) {
+  QAbstractScrollArea::resizeEvent(event);
+  updateScrollBars();
+  emit viewChanged();
+}
+
+void PageCanvas::scrollContentsBy(int dx, int dy) {
+  Q_UNUSED(dx);
+  Q_UNUSED(dy);
+
+  viewport()->update();
+  emit viewChanged();
+}
+
+void PageCanvas::updateScrollBars() {
+  QSize viewportSize = viewport()->size();
+
+  verticalScrollBar()->setPageStep(viewportSize.height());
+  verticalScrollBar()->setSingleStep(20);
+  verticalScrollBar()->setRange(
+      0, qMax(0, contentHeight() - viewportSize.height()));
+
+  horizontalScrollBar()->setPageStep(viewportSize.width());
+  horizontalScrollBar()->setSingleStep(20);
+  horizontalScrollBar()->setRange(
+      0, qMax(0, contentWidth() - viewportSize.width()));
+}
+
+int PageCanvas::contentWidth() const {
+  if (sheetCount() == 0)
+    return 0;
+
+  double maxWidth = isImposed() ? m_maxSheetWidth : m_document->maxPageWidth();
+  return qRound(maxWidth * m_dpi / 72.0);
+}
+
+int PageCanvas::contentHeight() const {
+  int count = sheetCount();
+  if (count == 0)
+    return 0;
+  return sheetRect(count - 1).bottom() + 1 + m_contentMargin;
+}
+
+void PageCanvas::updateContentRect(const QRect &rect) {
+  QPoint offset(horizontalScrollBar()->value(), verticalScrollBar()->value());
+  viewport()->update(rect.translated(-offset));
+}
+
+void PageCanvas::drawMargins(QPainter *painter, const QSize &sheetSize) {
+  double topPx = mmToPixels(m_printSettings->margins.top);
+  double bottomPx = mmToPixels(m_printSettings->margins.bottom);
+  double leftPx = mmToPixels(m_printSettings->margins.left);
+  double rightPx = mmToPixels(m_printSettings->margins.right);
+
+  int pageWidth = sheetSize.width();
+  int pageHeight = sheetSize.height();
+
+  QPen pen(QColor(255, 0, 0, 100));
+  pen.setStyle(Qt::DashLine);
+  pen.setWidth(2);
+  painter->setPen(pen);
+
+  QRectF marginRect(leftPx, topPx, pageWidth - leftPx - rightPx,
+                    pageHeight - topPx - bottomPx);
+
+  painter->drawRect(marginRect);
+
+  pen.setStyle(Qt::SolidLine);
+  pen.setWidth(1);
+  painter->setPen(pen);
+
+  int markerSize = 10;
+
+  painter->drawLine(0, topPx, markerSize, topPx);
+  painter->drawLine(leftPx, 0, leftPx, markerSize);
+
+  painter->drawLine(pageWidth - markerSize, topPx, pageWidth, topPx);
+  painter->drawLine(pageWidth - rightPx, 0, pageWidth - rightPx, markerSize);
+
+  painter->drawLine(0, pageHeight - bottomPx, markerSize,
+                    pageHeight - bottomPx);
+  painter->drawLine(leftPx, pageHeight - markerSize, leftPx, pageHeight);
+
+  painter->drawLine(pageWidth - markerSize, pageHeight - bottomPx, pageWidth,
+                    pageHeight - bottomPx);
+  painter->drawLine(pageWidth - rightPx, pageHeight - markerSize,
+                    pageWidth - rightPx, pageHeight);
+}
+
+void PageCanvas::drawDuplexIndicator(QPainter *painter, int sheet,
+                                     const QSize &sheetSize) {
+  // Hints alternate per printed side, which is a sheet once imposed
+  PrintSettings::DuplexMode duplexMode = m_printSettings->effectiveDuplexMode();
+  if (duplexMode == PrintSettings::Simplex)
+    return;
+
+  int x = 10;
+  int y = sheetSize.height() - 30;
+
+  painter->fillRect(x - 5, y - 5, 100, 25, QColor(0, 0, 0, 100));
+
+  painter->setPen(Qt::white);
+  QFont font = painter->font();
+  font.setPointSize(10);
+  painter->setFont(font);
+
+  QString text;
+  if (duplexMode == PrintSettings::DuplexLongEdge) {
+    if (sheet % 2 == 0) {
+      text = "↓ Flip ↓";
+    } else {
+      text = "↑ Flip ↑";
+    }
+  } else {
+    if (sheet % 2 == 0) {
+      text = "→ Flip →";
+    } else {
+      text = "← Flip ←";
+    }
+  }
+
+  painter->drawText(x, y, text);
+}
+
+double PageCanvas::mmToPixels(double mm) const { return (mm / 25.4) * m_dpi; }
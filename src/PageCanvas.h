@@ -0,0 +1,170 @@
+#ifndef PAGECANVAS_H_
+#define PAGECANVAS_H_
+
+#include "Imposition.h"
+#include "PrintSettings.h"
+#include <QAbstractScrollArea>
+#include <QColor>
+#include <QHash>
+#include <QList>
+#include <QPixmap>
+#include <QPoint>
+#include <QRect>
+#include <QStringList>
+#include <QVector>
+
+class Document;
+
+// Scroll area with a single viewport that paints the visible sheets,
+// separators and print overlays itself. Without an imposition every page is
+// its own sheet and positions come straight from the document's geometry
+// table, so widget count and layout cost do not grow with the page count.
+// With one, pages are painted into their cells on the imposed sheets.
+class PageCanvas : public QAbstractScrollArea {
+  Q_OBJECT
+
+public:
+  static const int TileSize = 512;
+
+  PageCanvas(QWidget *parent = nullptr);
+
+  void setDocument(const Document *document);
+  void setPrintSettings(const PrintSettings *settings);
+  void setDPI(double dpi);
+  double dpi() const;
+  void setPageGap(int gap);
+  void setPageBoundaries(bool show, const QColor &color);
+  void setTiledPixelThreshold(qint64 pixels);
+  qint64 tiledPixelThreshold() const;
+
+  // An empty list shows every page on its own sheet
+  void setImposition(const QVector<SheetLayout> &sheets);
+  bool isImposed() const;
+
+  int sheetCount() const;
+  QSizeF sheetSizePoints(int sheet) const;
+  QRect sheetRect(int sheet) const;
+  // Distance from the top of the sheet to the top of the next one
+  int sheetPitch(int sheet) const;
+  int sheetAt(int y) const;
+  int firstVisibleSheet() const;
+  int lastVisibleSheet() const;
+  int sheetOfPage(int pageNumber) const;
+  QVector<int> pagesOnSheet(int sheet) const;
+
+  int pageCount() const;
+  QSize pagePixelSize(int pageNumber) const;
+  QRect pageRect(int pageNumber) const;
+  // Size of the page on its sheet relative to its own size, 1.0 when 1-up
+  double pageScale(int pageNumber) const;
+  QRect viewRect() const;
+  int pageNearestCenter() const;
+  bool isTiled(int pageNumber) const;
+  void scrollToPage(int pageNumber);
+  // Centers a rectangle given in page points vertically in the view
+  void scrollToPageRect(int pageNumber, const QRectF &rect);
+
+  void setPagePixmap(int pageNumber, const QPixmap &pixmap);
+  void clearPage(int pageNumber);
+  void clearAllPages();
+  // Keeps the page's raster on screen as a preview until it is replaced
+  void invalidatePage(int pageNumber);
+  // Picks up new page geometry after the document was reloaded in place,
+  // keeping the scroll position and the rasters of pages that still exist
+  void documentReloaded();
+  bool hasPagePixmap(int pageNumber) const;
+
+  // A preview is any raster that does not match the current DPI. It is
+  // painted scaled to the page until the full-resolution pixmap arrives.
+  void setPreviewPixmap(int pageNumber, const QPixmap &pixmap);
+  bool hasAnyPixmap(int pageNumber) const;
+
+  // Tiled pages are painted from TileSize squares over their preview
+  void setTile(int pageNumber, const QPoint &index, const QPixmap &pixmap);
+  bool hasTile(int pageNumber, const QPoint &index) const;
+  void retainTiles(int pageNumber, const QRect &tileRange);
+
+  // Replaces the page's raster with one divisor times smaller, painted
+  // stretched like a preview. Does nothing to rasters that small already.
+  void downscalePage(int pageNumber, double divisor);
+  QList<int> rasterPages() const;
+
+  // Bytes held by the page and tile pixmaps currently on the canvas
+  qint64 rasterBytes() const;
+  // Duration of the most recent paint event
+  double lastPaintMs() const;
+
+  // Search hits per page in page points. The current hit is drawn in a
+  // stronger color.
+  void setHighlights(const QHash<int, QVector<QRectF>> &highlights,
+                     int currentPage = -1, const QRectF &current = QRectF());
+
+  // Lines shown in the corner overlay; an empty list hides it
+  void setHudLines(const QStringList &lines);
+
+signals:
+  void viewChanged();
+
+protected:
+  void paintEvent(QPaintEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+  void scrollContentsBy(int dx, int dy) override;
+
+private:
+  struct PageRaster {
+    QPixmap pixmap;
+    bool isPreview = false;
+    QHash<QPoint, QPixmap> tiles;
+  };
+
+  void updateScrollBars();
+  QSize sheetPixelSize(int sheet) const;
+  double sheetOffset(int sheet) const;
+  int sheetStride() const;
+  int sheetTop(int sheet) const;
+  const PagePlacement *placementOf(int pageNumber) const;
+  QRect placementRect(const QRectF &points) const;
+  int contentWidth() const;
+  int contentHeight() const;
+  void updateContentRect(const QRect &rect);
+
+  void paintSheets(QPainter *painter, const QRect &dirty);
+  void paintSheet(QPainter *painter, int sheet, const QRect &exposed);
+  void paintPage(QPainter *painter, int pageNumber, const QSize &pageSize,
+                 const QRect &exposed);
+  void drawMargins(QPainter *painter, const QSize &sheetSize);
+  void drawDuplexIndicator(QPainter *painter, int sheet,
+                           const QSize &sheetSize);
+  void drawHighlights(QPainter *painter, int pageNumber,
+                      const QSize &pageSize);
+  QRect hudRect() const;
+  void drawHud(QPainter *painter);
+
+  double mmToPixels(double mm) const;
+
+  const Document *m_document;
+  const PrintSettings *m_printSettings;
+  double m_dpi;
+
+  int m_pageGap;
+  int m_contentMargin;
+  bool m_showPageBoundaries;
+  QColor m_pageBoundaryColor;
+  qint64 m_tiledPixelThreshold;
+
+  QVector<SheetLayout> m_sheets;
+  QVector<double> m_sheetOffsets;
+  QVector<int> m_pageSheets;
+  double m_maxSheetWidth;
+
+  QHash<int, PageRaster> m_rasters;
+
+  QHash<int, QVector<QRectF>> m_highlights;
+  int m_currentHighlightPage;
+  QRectF m_currentHighlight;
+
+  double m_lastPaintMs;
+  QStringList m_hudLines;
+};
+
+#endif // PAGECANVAS_H_
@@ -0,0 +1,184 @@
+#include "PrintJob.h"
+#include "Imposition.h"
+#include "SheetRenderer.h"
+#include <QMutexLocker>
+#include <QPageLayout>
+#include <QPageSize>
+#include <QPainter>
+#include <QPrinter>
+#include <QThread>
+
+PrintJob::PrintJob(const QString &filePath, Document::LoadMode loadMode,
+                   const PrintSettings &settings, int pageCount,
+                   const QString &outputFile, QObject *parent)
+    : QObject(parent), m_filePath(filePath), m_loadMode(loadMode),
+      m_settings(settings), m_outputFile(outputFile), m_dpi(300.0),
+      m_pages(settings.rangePages(pageCount)),
+      m_sheetCount(Imposition::sheetCount(settings.pageLayout, m_pages.size())),
+      m_renderThread(nullptr),
+      m_printThread(nullptr), m_renderDone(false), m_cancelled(0) {}
+
+PrintJob::~PrintJob() {
+  cancel();
+
+  for (QThread *thread : {m_renderThread, m_printThread}) {
+    if (thread) {
+      thread->wait();
+      delete thread;
+    }
+  }
+}
+
+void PrintJob::start() {
+  m_renderThread = QThread::create([this]() { renderLoop(); });
+  m_printThread = QThread::create([this]() { printLoop(); });
+  m_renderThread->start();
+  m_printThread->start();
+}
+
+void PrintJob::cancel() {
+  m_cancelled.storeRelease(1);
+
+  QMutexLocker locker(&m_mutex);
+  m_sheetReady.wakeAll();
+  m_slotFree.wakeAll();
+}
+
+int PrintJob::totalSheets() const { return m_sheetCount; }
+
+void PrintJob::renderLoop() {
+  Document document;
+
+  if (!document.load(m_filePath, m_loadMode)) {
+    QMutexLocker locker(&m_mutex);
+    m_renderError = document.errorString();
+    m_renderDone = true;
+    m_sheetReady.wakeAll();
+    return;
+  }
+
+  for (int i = 0; i < m_sheetCount; i++) {
+    if (m_cancelled.loadAcquire())
+      break;
+
+    SheetLayout layout =
+        Imposition::sheet(document, m_settings, m_pages, i);
+
+    Sheet sheet;
+    sheet.sheetIndex = i;
+    sheet.paperPoints = layout.paperPoints;
+    // Cancelling stops the sheet part way, so the GUI thread waiting in
+    // the destructor is not held up by a full 300 DPI render
+    sheet.image = SheetRenderer::render(document, layout, m_dpi, m_settings,
+                                        &m_cancelled);
+    if (m_cancelled.loadAcquire())
+      break;
+
+    QMutexLocker locker(&m_mutex);
+    while (m_sheets.size() >= QueueDepth && !m_cancelled.loadAcquire())
+      m_slotFree.wait(&m_mutex);
+
+    m_sheets.enqueue(sheet);
+    m_sheetReady.wakeOne();
+  }
+
+  QMutexLocker locker(&m_mutex);
+  m_renderDone = true;
+  m_sheetReady.wakeAll();
+}
+
+bool PrintJob::takeSheet(Sheet *sheet) {
+  QMutexLocker locker(&m_mutex);
+  while (m_sheets.isEmpty() && !m_renderDone && !m_cancelled.loadAcquire())
+    m_sheetReady.wait(&m_mutex);
+
+  if (m_sheets.isEmpty() || m_cancelled.loadAcquire())
+    return false;
+
+  *sheet = m_sheets.dequeue();
+  m_slotFree.wakeOne();
+  return true;
+}
+
+void PrintJob::printLoop() {
+  QPrinter printer(QPrinter::HighResolution);
+  printer.setFullPage(true);
+  printer.setDocName(m_filePath);
+
+  // A job whose pages all print in grayscale goes out as a grayscale job
+  bool anyColor = false;
+  for (int page : m_pages)
+    anyColor = anyColor || m_settings.pageInColor(page);
+  printer.setColorMode(anyColor ? QPrinter::Color : QPrinter::GrayScale);
+
+  switch (m_settings.effectiveDuplexMode()) {
+  case PrintSettings::Simplex:
+    printer.setDuplex(QPrinter::DuplexNone);
+    break;
+  case PrintSettings::DuplexLongEdge:
+    printer.setDuplex(QPrinter::DuplexLongSide);
+    break;
+  case PrintSettings::DuplexShortEdge:
+    printer.setDuplex(QPrinter::DuplexShortSide);
+    break;
+  }
+
+  if (!m_outputFile.isEmpty()) {
+    printer.setOutputFormat(QPrinter::PdfFormat);
+    printer.setOutputFileName(m_outputFile);
+  }
+
+  QPainter painter;
+  int printed = 0;
+  int total = totalSheets();
+
+  Sheet sheet;
+  while (takeSheet(&sheet)) {
+    // 1-up sheets keep the paper size of the page they came from
+    printer.setPageSize(QPageSize(sheet.paperPoints, QPageSize::Point));
+
+    if (printed == 0) {
+      if (!painter.begin(&printer)) {
+        cancel();
+        emit finished(false, "Cannot open printer");
+        return;
+      }
+    } else if (!printer.newPage()) {
+      cancel();
+      painter.end();
+      emit finished(false, "Printer rejected a new page");
+      return;
+    }
+
+    QRect target = printer.pageLayout().fullRectPixels(printer.resolution());
+    painter.drawImage(target, sheet.image);
+    sheet.image = QImage();
+
+    printed++;
+    emit progress(printed, total);
+  }
+
+  bool cancelled = m_cancelled.loadAcquire();
+  if (!cancelled && printed == 0) {
+    QMutexLocker locker(&m_mutex);
+    emit finished(false, m_renderError.isEmpty() ? "Nothing to print"
+                                                 : m_renderError);
+    return;
+  }
+
+  if (cancelled && painter.isActive())
+    printer.abort();
+  if (painter.isActive())
+    painter.end();
+
+  if (cancelled) {
+    emit finished(false, "Cancelled");
+    return;
+  }
+
+  QMutexLocker locker(&m_mutex);
+  if (!m_renderError.isEmpty())
+    emit finished(false, m_renderError);
+  else
+    emit finished(true, QString());
+}
@@ -0,0 +1,73 @@
+#ifndef PRINTJOB_H_
+#define PRINTJOB_H_
+
+#include "Document.h"
+#include "PrintSettings.h"
+#include <QAtomicInt>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QSizeF>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+
+class QThread;
+
+// Streams a document to a printer, or to a PDF when an output file is given,
+// one imposed sheet at a time. A render thread stays at most QueueDepth
+// sheets ahead of the spooling thread, so memory does not grow with the page
+// count and the GUI thread is never involved.
+class PrintJob : public QObject {
+  Q_OBJECT
+
+public:
+  static const int QueueDepth = 2;
+
+  PrintJob(const QString &filePath, Document::LoadMode loadMode,
+           const PrintSettings &settings, int pageCount,
+           const QString &outputFile, QObject *parent = nullptr);
+  ~PrintJob();
+
+  void start();
+  void cancel();
+  int totalSheets() const;
+
+signals:
+  void progress(int printed, int total);
+  void finished(bool success, const QString &error);
+
+private:
+  struct Sheet {
+    int sheetIndex;
+    QSizeF paperPoints;
+    QImage image;
+  };
+
+  void renderLoop();
+  void printLoop();
+  bool takeSheet(Sheet *sheet);
+
+  QString m_filePath;
+  Document::LoadMode m_loadMode;
+  PrintSettings m_settings;
+  QString m_outputFile;
+  double m_dpi;
+  QVector<int> m_pages;
+  int m_sheetCount;
+
+  QThread *m_renderThread;
+  QThread *m_printThread;
+
+  QMutex m_mutex;
+  QWaitCondition m_sheetReady;
+  QWaitCondition m_slotFree;
+  QQueue<Sheet> m_sheets;
+  bool m_renderDone;
+  QString m_renderError;
+
+  QAtomicInt m_cancelled;
+};
+
+#endif // PRINTJOB_H_
@@ -1,13 +1,20 @@
 #ifndef PRINTSETTINGS_H_
 #define PRINTSETTINGS_H_
 
+#include <QRectF>
+#include <QSet>
+#include <QSizeF>
 #include <QString>
+#include <QVector>
+#include <QtGlobal>
 
 struct PrintSettings {
   enum ScaleMode { FitToPage, ActualSize, CustomPercent };
 
   enum DuplexMode { Simplex, DuplexLongEdge, DuplexShortEdge };
 
+  enum PageLayout { OneUp, TwoUp, FourUp, Booklet };
+
   struct Margins {
     double top;
     double bottom;
@@ -22,16 +29,23 @@ struct PrintSettings {
   int customPercent;
   Margins margins;
   DuplexMode duplexMode;
+  PageLayout pageLayout;
   bool colorMode;
 
   bool printAllPages;
   int fromPage;
   int toPage;
+  // Zero-based pages left out of the range, such as detected blank pages
+  QSet<int> excludedPages;
+  // Zero-based pages printed in grayscale even in colour mode, such as
+  // pages found to have no colour
+  QSet<int> grayscalePages;
 
   PrintSettings()
       : scaleMode(FitToPage), customPercent(100),
-        margins(10.0, 10.0, 10.0, 10.0), duplexMode(Simplex), colorMode(true),
-        printAllPages(true), fromPage(1), toPage(1) {}
+        margins(10.0, 10.0, 10.0, 10.0), duplexMode(Simplex),
+        pageLayout(OneUp), colorMode(true), printAllPages(true), fromPage(1),
+        toPage(1) {}
 
   static Margins marginPresetNone() { return Margins(0, 0, 0, 0); }
   static Margins marginPresetMinimal() { return Margins(5, 5, 5, 5); }
@@ -39,6 +53,69 @@ struct PrintSettings {
   static Margins marginPresetComfortable() { return Margins(15, 15, 15, 15); }
   static Margins marginPresetWide() { return Margins(20, 20, 25, 25); }
 
+  static bool marginPresetFromName(const QString &name, Margins *margins) {
+    QString preset = name.toLower();
+    if (preset == "none")
+      *margins = marginPresetNone();
+    else if (preset == "minimal")
+      *margins = marginPresetMinimal();
+    else if (preset == "normal")
+      *margins = marginPresetNormal();
+    else if (preset == "comfortable")
+      *margins = marginPresetComfortable();
+    else if (preset == "wide")
+      *margins = marginPresetWide();
+    else
+      return false;
+    return true;
+  }
+
+  static bool pageLayoutFromName(const QString &name, PageLayout *layout) {
+    QString value = name.toLower();
+    if (value == "1up")
+      *layout = OneUp;
+    else if (value == "2up")
+      *layout = TwoUp;
+    else if (value == "4up")
+      *layout = FourUp;
+    else if (value == "booklet")
+      *layout = Booklet;
+    else
+      return false;
+    return true;
+  }
+
+  // Zero-based, inclusive page range selected for printing
+  int rangeFirst(int pageCount) const {
+    if (printAllPages)
+      return 0;
+    return qBound(0, fromPage - 1, pageCount - 1);
+  }
+
+  int rangeLast(int pageCount) const {
+    if (printAllPages)
+      return pageCount - 1;
+    return qBound(0, toPage - 1, pageCount - 1);
+  }
+
+  bool pageInColor(int pageNumber) const {
+    return colorMode && !grayscalePages.contains(pageNumber);
+  }
+
+  // Pages that are printed, in order
+  QVector<int> rangePages(int pageCount) const {
+    QVector<int> pages;
+    if (pageCount <= 0)
+      return pages;
+
+    int last = rangeLast(pageCount);
+    for (int page = rangeFirst(pageCount); page <= last; page++) {
+      if (!excludedPages.contains(page))
+        pages.append(page);
+    }
+    return pages;
+  }
+
   QString marginPresetName() const {
     if (margins.top == 0 && margins.left == 0)
       return "None";
@@ -66,6 +143,77 @@ struct PrintSettings {
     }
   }
 
+  // Booklets are folded along the short edge, so their sides always flip
+  // that way regardless of the chosen duplex mode
+  DuplexMode effectiveDuplexMode() const {
+    if (pageLayout == Booklet)
+      return DuplexShortEdge;
+    return duplexMode;
+  }
+
+  QString pageLayoutName() const {
+    switch (pageLayout) {
+    case OneUp:
+      return "1-up";
+    case TwoUp:
+      return "2-up";
+    case FourUp:
+      return "4-up";
+    case Booklet:
+      return "Booklet";
+    default:
+      return "Unknown";
+    }
+  }
+
+  static double mmToPoints(double mm) { return mm * 72.0 / 25.4; }
+
+  // Printable area of a sheet, in points
+  QRectF marginRect(const QSizeF &paperPoints) const {
+    double left = mmToPoints(margins.left);
+    double top = mmToPoints(margins.top);
+    double right = mmToPoints(margins.right);
+    double bottom = mmToPoints(margins.bottom);
+
+    return QRectF(left, top, qMax(0.0, paperPoints.width() - left - right),
+                  qMax(0.0, paperPoints.height() - top - bottom));
+  }
+
+  // Where a page of the given size lands on the sheet, in points, according
+  // to the scale mode. The result may overflow the printable area for
+  // ActualSize and CustomPercent and is expected to be clipped.
+  QRectF targetRect(const QSizeF &paperPoints, const QSizeF &pagePoints) const {
+    QRectF area = marginRect(paperPoints);
+    if (pagePoints.isEmpty())
+      return area;
+
+    double scale = 1.0;
+    switch (scaleMode) {
+    case FitToPage:
+      scale = qMin(area.width() / pagePoints.width(),
+                   area.height() / pagePoints.height());
+      break;
+    case ActualSize:
+      scale = 1.0;
+      break;
+    case CustomPercent:
+      scale = customPercent / 100.0;
+      break;
+    }
+
+    QSizeF size = pagePoints * scale;
+    QPointF origin(area.left() + (area.width() - size.width()) / 2,
+                   area.top() + (area.height() - size.height()) / 2);
+
+    // Content larger than the printable area starts at its top-left corner
+    if (size.width() > area.width())
+      origin.setX(area.left());
+    if (size.height() > area.height())
+      origin.setY(area.top());
+
+    return QRectF(origin, size);
+  }
+
   QString scaleModeName() const {
     switch (scaleMode) {
     case FitToPage:
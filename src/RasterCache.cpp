@@ -0,0 +1,74 @@
+#include "RasterCache.h"
+
+RasterCache::RasterCache(qint64 maxBytes)
+    : m_cache(maxBytes), m_hits(0), m_misses(0) {}
+
+QImage RasterCache::find(const RasterKey &key) {
+  QImage *image = m_cache.object(key);
+
+  if (!image) {
+    m_misses++;
+    return QImage();
+  }
+
+  m_hits++;
+  return *image;
+}
+
+QImage RasterCache::peek(const RasterKey &key) {
+  QImage *image = m_cache.object(key);
+  return image ? *image : QImage();
+}
+
+void RasterCache::recordLookup(bool hit) {
+  if (hit)
+    m_hits++;
+  else
+    m_misses++;
+}
+
+void RasterCache::insert(const RasterKey &key, const QImage &image) {
+  if (image.isNull())
+    return;
+
+  // Images larger than the whole budget are rejected by QCache and deleted
+  m_cache.insert(key, new QImage(image), image.sizeInBytes());
+}
+
+void RasterCache::clear() { m_cache.clear(); }
+
+void RasterCache::removePage(int document, int pageNumber) {
+  const QList<RasterKey> keys = m_cache.keys();
+  for (const RasterKey &key : keys) {
+    if (key.document == document && key.pageNumber == pageNumber)
+      m_cache.remove(key);
+  }
+}
+
+void RasterCache::removeDocument(int document) {
+  const QList<RasterKey> keys = m_cache.keys();
+  for (const RasterKey &key : keys) {
+    if (key.document == document)
+      m_cache.remove(key);
+  }
+}
+
+void RasterCache::setMaxBytes(qint64 maxBytes) { m_cache.setMaxCost(maxBytes); }
+
+qint64 RasterCache::maxBytes() const { return m_cache.maxCost(); }
+
+qint64 RasterCache::usedBytes() const { return m_cache.totalCost(); }
+
+int RasterCache::count() const { return m_cache.count(); }
+
+double RasterCache::hitRate() const {
+  quint64 total = m_hits + m_misses;
+  if (total == 0)
+    return 0.0;
+  return double(m_hits) / double(total);
+}
+
+void RasterCache::resetStats() {
+  m_hits = 0;
+  m_misses = 0;
+}
@@ -0,0 +1,71 @@
+#ifndef RASTERCACHE_H_
+#define RASTERCACHE_H_
+
+#include <QCache>
+#include <QHashFunctions>
+#include <QImage>
+#include <QPoint>
+
+// A whole page has a tile of (-1, -1); tiles are indexed in tile units.
+// document tells apart the open documents sharing one cache.
+struct RasterKey {
+  int document;
+  int pageNumber;
+  int dpiKey;
+  bool colorMode;
+  QPoint tile;
+
+  RasterKey()
+      : document(0), pageNumber(-1), dpiKey(0), colorMode(true),
+        tile(-1, -1) {}
+  RasterKey(int documentId, int page, double dpi, bool color,
+            const QPoint &tileIndex = QPoint(-1, -1))
+      : document(documentId), pageNumber(page), dpiKey(qRound(dpi * 100.0)),
+        colorMode(color), tile(tileIndex) {}
+
+  bool operator==(const RasterKey &other) const {
+    return document == other.document && pageNumber == other.pageNumber &&
+           dpiKey == other.dpiKey && colorMode == other.colorMode &&
+           tile == other.tile;
+  }
+};
+
+inline size_t qHash(const RasterKey &key, size_t seed = 0) {
+  return qHashMulti(seed, key.document, key.pageNumber, key.dpiKey,
+                    key.colorMode, key.tile.x(), key.tile.y());
+}
+
+// LRU cache of rendered page images bounded by a byte budget. One cache is
+// shared by every open document, so the budget holds however many are open.
+class RasterCache {
+public:
+  explicit RasterCache(qint64 maxBytes = 256ll * 1024 * 1024);
+
+  QImage find(const RasterKey &key);
+  // find() without counting, for lookups that probe several keys and
+  // record the outcome once with recordLookup()
+  QImage peek(const RasterKey &key);
+  void recordLookup(bool hit);
+  void insert(const RasterKey &key, const QImage &image);
+  void clear();
+  // Drops every raster and tile of a page, or of a whole document
+  void removePage(int document, int pageNumber);
+  void removeDocument(int document);
+
+  void setMaxBytes(qint64 maxBytes);
+  qint64 maxBytes() const;
+  qint64 usedBytes() const;
+  int count() const;
+
+  quint64 hits() const { return m_hits; }
+  quint64 misses() const { return m_misses; }
+  double hitRate() const;
+  void resetStats();
+
+private:
+  QCache<RasterKey, QImage> m_cache;
+  quint64 m_hits;
+  quint64 m_misses;
+};
+
+#endif // RASTERCACHE_H_
@@ -0,0 +1,228 @@
+#include "RenderEngine.h"
+#include "DiskCache.h"
+#include "Grayscale.h"
+#include "Trace.h"
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+#include <vector>
+
+RenderEngine::RenderEngine(QObject *parent)
+    : QObject(parent), m_activeDocument(-1), m_documentRevision(0),
+      m_stopping(false), m_rendering(0), m_rendered(0), m_lastPage(-1),
+      m_lastRenderMs(0.0), m_totalRenderMs(0.0), m_generation(0) {
+  int threads = qMax(1, QThread::idealThreadCount());
+
+  for (int i = 0; i < threads; i++) {
+    QThread *worker = QThread::create([this]() { workerLoop(); });
+    worker->start();
+    m_workers.append(worker);
+  }
+}
+
+RenderEngine::~RenderEngine() {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_stopping = true;
+    m_queue.clear();
+  }
+  m_jobAvailable.wakeAll();
+
+  for (QThread *worker : m_workers) {
+    worker->wait();
+    delete worker;
+  }
+}
+
+void RenderEngine::setDocument(int documentId, const QString &filePath,
+                               Document::LoadMode mode,
+                               const QByteArray &contentHash) {
+  if (documentId == m_activeDocument)
+    cancelAll();
+
+  QMutexLocker locker(&m_mutex);
+  m_documents.insert(documentId,
+                     {filePath, mode, contentHash, ++m_documentRevision});
+}
+
+void RenderEngine::removeDocument(int documentId) {
+  if (documentId == m_activeDocument)
+    cancelAll();
+
+  // Workers close their copies the next time they take a job
+  QMutexLocker locker(&m_mutex);
+  m_documents.remove(documentId);
+}
+
+void RenderEngine::setActiveDocument(int documentId) {
+  cancelAll();
+
+  QMutexLocker locker(&m_mutex);
+  m_activeDocument = documentId;
+}
+
+void RenderEngine::setDiskCache(std::shared_ptr<DiskCache> cache) {
+  QMutexLocker locker(&m_mutex);
+  m_diskCache = std::move(cache);
+}
+
+void RenderEngine::requestPage(int pageNumber, double dpi, bool grayscale) {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_queue.enqueue({m_activeDocument, pageNumber, dpi, grayscale, QRect(),
+                     m_generation.loadAcquire()});
+  }
+  m_jobAvailable.wakeOne();
+}
+
+void RenderEngine::requestTile(int pageNumber, double dpi, bool grayscale,
+                               const QRect &tile) {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_queue.enqueue({m_activeDocument, pageNumber, dpi, grayscale, tile,
+                     m_generation.loadAcquire()});
+  }
+  m_jobAvailable.wakeOne();
+}
+
+void RenderEngine::cancelAll() {
+  QMutexLocker locker(&m_mutex);
+  m_queue.clear();
+  m_generation.fetchAndAddOrdered(1);
+}
+
+int RenderEngine::threadCount() const { return m_workers.size(); }
+
+RenderEngine::Stats RenderEngine::stats() const {
+  QMutexLocker locker(&m_mutex);
+
+  Stats stats;
+  stats.queued = m_queue.size();
+  stats.rendering = m_rendering;
+  stats.rendered = m_rendered;
+  stats.lastPage = m_lastPage;
+  stats.lastRenderMs = m_lastRenderMs;
+  stats.averageRenderMs = m_rendered ? m_totalRenderMs / m_rendered : 0.0;
+  return stats;
+}
+
+void RenderEngine::workerLoop() {
+  struct OpenDocument {
+    int id;
+    quint64 revision;
+    std::unique_ptr<Document> document;
+  };
+
+  // Most recently used first
+  std::vector<OpenDocument> open;
+
+  while (true) {
+    Job job;
+    Source source;
+    bool registered;
+    std::shared_ptr<DiskCache> diskCache;
+
+    {
+      QMutexLocker locker(&m_mutex);
+      while (m_queue.isEmpty() && !m_stopping)
+        m_jobAvailable.wait(&m_mutex);
+
+      if (m_stopping)
+        return;
+
+      job = m_queue.dequeue();
+      m_rendering++;
+      registered = m_documents.contains(job.document);
+      source = m_documents.value(job.document);
+      diskCache = m_diskCache;
+
+      // Revisions start at 1, so 0 marks a document that was closed
+      for (OpenDocument &entry : open) {
+        if (!m_documents.contains(entry.id))
+          entry.revision = 0;
+      }
+    }
+
+    // Closed documents are released along with their mappings, outside the
+    // lock the GUI thread queues requests under
+    open.erase(std::remove_if(open.begin(), open.end(),
+                              [](const OpenDocument &entry) {
+                                return entry.revision == 0;
+                              }),
+               open.end());
+
+    if (job.generation != m_generation.loadAcquire() || !registered) {
+      QMutexLocker locker(&m_mutex);
+      m_rendering--;
+      continue;
+    }
+
+    auto found = open.begin();
+    while (found != open.end() && found->id != job.document)
+      ++found;
+
+    if (found == open.end() || found->revision != source.revision) {
+      if (found != open.end())
+        open.erase(found);
+      if (int(open.size()) >= KeptDocuments)
+        open.pop_back();
+
+      auto document = std::make_unique<Document>();
+      document->load(source.filePath, source.loadMode);
+      open.insert(open.begin(),
+                  {job.document, source.revision, std::move(document)});
+    } else if (found != open.begin()) {
+      std::rotate(open.begin(), found, found + 1);
+    }
+
+    const Document &document = *open.front().document;
+
+    QImage image = job.tile.isNull()
+                       ? document.renderPage(job.pageNumber, job.dpi)
+                       : document.renderTile(job.pageNumber, job.dpi, job.tile);
+
+    {
+      QMutexLocker locker(&m_mutex);
+      m_rendering--;
+      if (!image.isNull()) {
+        m_rendered++;
+        m_lastPage = job.pageNumber;
+        m_lastRenderMs = document.lastRenderMs();
+        m_totalRenderMs += m_lastRenderMs;
+      }
+    }
+
+    if (image.isNull())
+      continue;
+
+    if (job.grayscale) {
+      TraceSpan span("convert", job.pageNumber, job.dpi);
+      image = Grayscale::fromColor(image);
+    }
+
+    if (diskCache && job.tile.isNull())
+      diskCache->store(source.contentHash,
+                       RasterKey(job.document, job.pageNumber, job.dpi,
+                                 !job.grayscale),
+                       image);
+
+    deliver(job, image);
+  }
+}
+
+void RenderEngine::deliver(const Job &job, const QImage &image) {
+  // Hop to the engine's thread so stale results can be dropped against the
+  // generation the GUI currently expects
+  QMetaObject::invokeMethod(
+      this,
+      [this, job, image]() {
+        if (job.generation != m_generation.loadAcquire())
+          return;
+        if (job.tile.isNull())
+          emit pageRendered(job.pageNumber, job.dpi, image);
+        else
+          emit tileRendered(job.pageNumber, job.dpi, job.tile, image);
+      },
+      Qt::QueuedConnection);
+}
@@ -0,0 +1,107 @@
+#ifndef RENDERENGINE_H_
+#define RENDERENGINE_H_
+
+#include "Document.h"
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QRect>
+#include <QString>
+#include <QWaitCondition>
+#include <memory>
+
+class DiskCache;
+class QThread;
+
+// Rasterizes pages on a pool of worker threads. Each worker opens its own
+// Document so Poppler is never shared between threads. One pool serves every
+// open document: requests go to the active one, and each worker keeps the
+// last few documents it used open so switching between them is free.
+class RenderEngine : public QObject {
+  Q_OBJECT
+
+public:
+  explicit RenderEngine(QObject *parent = nullptr);
+  ~RenderEngine();
+
+  static const int KeptDocuments = 2;
+
+  // Registers a document under an id, or refreshes it after its file
+  // changed. Whole-page renders are also written to the disk cache, when
+  // one is set, under the document's content hash.
+  void setDocument(int documentId, const QString &filePath,
+                   Document::LoadMode mode = Document::ReadFile,
+                   const QByteArray &contentHash = QByteArray());
+  void removeDocument(int documentId);
+  // Requests are for the active document. Switching cancels queued work.
+  void setActiveDocument(int documentId);
+  void setDiskCache(std::shared_ptr<DiskCache> cache);
+  void requestPage(int pageNumber, double dpi, bool grayscale);
+  void requestTile(int pageNumber, double dpi, bool grayscale,
+                   const QRect &tile);
+  void cancelAll();
+  int threadCount() const;
+
+  struct Stats {
+    int queued;
+    int rendering;
+    quint64 rendered;
+    int lastPage;
+    double lastRenderMs;
+    double averageRenderMs;
+  };
+
+  Stats stats() const;
+
+signals:
+  // Only delivered for requests made since the last cancelAll()
+  void pageRendered(int pageNumber, double dpi, const QImage &image);
+  void tileRendered(int pageNumber, double dpi, const QRect &tile,
+                    const QImage &image);
+
+private:
+  struct Job {
+    int document;
+    int pageNumber;
+    double dpi;
+    bool grayscale;
+    QRect tile;
+    quint64 generation;
+  };
+
+  struct Source {
+    QString filePath;
+    Document::LoadMode loadMode;
+    QByteArray contentHash;
+    quint64 revision;
+  };
+
+  void workerLoop();
+  void deliver(const Job &job, const QImage &image);
+
+  QList<QThread *> m_workers;
+
+  mutable QMutex m_mutex;
+  QWaitCondition m_jobAvailable;
+  QQueue<Job> m_queue;
+  QHash<int, Source> m_documents;
+  int m_activeDocument;
+  std::shared_ptr<DiskCache> m_diskCache;
+  quint64 m_documentRevision;
+  bool m_stopping;
+
+  int m_rendering;
+  quint64 m_rendered;
+  int m_lastPage;
+  double m_lastRenderMs;
+  double m_totalRenderMs;
+
+  QAtomicInteger<quint64> m_generation;
+};
+
+#endif // RENDERENGINE_H_
@@ -0,0 +1,53 @@
+#include "SheetRenderer.h"
+#include "Document.h"
+#include "Grayscale.h"
+#include "Trace.h"
+#include <QPainter>
+
+QImage SheetRenderer::render(const Document &document,
+                             const SheetLayout &layout, double dpi,
+                             const PrintSettings &settings,
+                             const QAtomicInt *cancelled) {
+  if (layout.paperPoints.isEmpty())
+    return QImage();
+
+  double scale = dpi / 72.0;
+  QSize sheetSize = (layout.paperPoints * scale).toSize();
+
+  QImage sheet(sheetSize, QImage::Format_RGB32);
+  sheet.fill(Qt::white);
+
+  QPainter painter(&sheet);
+
+  for (const PagePlacement &placement : layout.placements) {
+    QRectF visible = placement.rect.intersected(placement.clip);
+    QSizeF pagePoints = document.pageSize(placement.pageNumber);
+    if (visible.isEmpty() || pagePoints.isEmpty())
+      continue;
+
+    // Render straight at the target size, and only the part that survives
+    // the clip, instead of rendering the full page and scaling
+    double pageDpi = dpi * placement.rect.width() / pagePoints.width();
+    QRect tile = QRectF((visible.topLeft() - placement.rect.topLeft()) * scale,
+                        visible.size() * scale)
+                     .toAlignedRect();
+
+    QImage content =
+        document.renderTile(placement.pageNumber, pageDpi, tile, cancelled);
+    if (cancelled && cancelled->loadAcquire())
+      return QImage();
+    if (settings.colorMode && !settings.pageInColor(placement.pageNumber)) {
+      TraceSpan span("convert", placement.pageNumber, pageDpi);
+      content = Grayscale::fromColor(content);
+    }
+    painter.drawImage((visible.topLeft() * scale).toPoint(), content);
+  }
+
+  painter.end();
+
+  if (!settings.colorMode) {
+    TraceSpan span("convert");
+    return Grayscale::fromColor(sheet);
+  }
+  return sheet;
+}
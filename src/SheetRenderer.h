@@ -0,0 +1,22 @@
+#ifndef SHEETRENDERER_H_
+#define SHEETRENDERER_H_
+
+#include "Imposition.h"
+#include "PrintSettings.h"
+#include <QAtomicInt>
+#include <QImage>
+
+class Document;
+
+// Renders a sheet the way it will come out of the printer: every placed
+// page rendered straight at its cell size, clipped to its cell and
+// converted to grayscale when color is off.
+class SheetRenderer {
+public:
+  // A set cancel flag stops the render part way and yields a null image
+  static QImage render(const Document &document, const SheetLayout &layout,
+                       double dpi, const PrintSettings &settings,
+                       const QAtomicInt *cancelled = nullptr);
+};
+
+#endif // SHEETRENDERER_H_
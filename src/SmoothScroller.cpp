@@ -0,0 +1,100 @@
+#include "SmoothScroller.h"
+#include <QScrollBar>
+#include <QTimer>
+#include <QtMath>
+
+namespace {
+
+// About one display refresh
+const int FrameMs = 16;
+
+// Each frame closes the same fraction of the remaining distance per unit
+// of time: a step is 63% done after this long and settled after about
+// four times it, short enough to keep up with key repeat
+const double EaseSeconds = 0.07;
+
+} // namespace
+
+SmoothScroller::SmoothScroller(QScrollBar *scrollBar, QObject *parent)
+    : QObject(parent), m_scrollBar(scrollBar), m_frameTimer(nullptr),
+      m_enabled(true), m_updating(false), m_position(0.0), m_target(0.0),
+      m_velocity(0.0) {
+  m_frameTimer = new QTimer(this);
+  m_frameTimer->setTimerType(Qt::PreciseTimer);
+  m_frameTimer->setInterval(FrameMs);
+  connect(m_frameTimer, &QTimer::timeout, this, &SmoothScroller::onFrame);
+  connect(m_scrollBar, &QScrollBar::valueChanged, this,
+          &SmoothScroller::onValueChanged);
+}
+
+void SmoothScroller::setEnabled(bool enabled) {
+  m_enabled = enabled;
+  if (!enabled)
+    stop();
+}
+
+bool SmoothScroller::isEnabled() const { return m_enabled; }
+
+void SmoothScroller::scrollBy(int pixels) {
+  if (!m_enabled) {
+    m_scrollBar->setValue(m_scrollBar->value() + pixels);
+    return;
+  }
+
+  if (!isScrolling()) {
+    m_position = m_scrollBar->value();
+    m_target = m_position;
+    m_velocity = 0.0;
+    m_clock.start();
+  }
+
+  // Steps add to the target rather than restarting from the current
+  // position, so key repeat keeps the speed constant
+  m_target = qBound<double>(m_scrollBar->minimum(), m_target + pixels,
+                            m_scrollBar->maximum());
+
+  if (qAbs(m_target - m_position) < 0.5)
+    stop();
+  else if (!m_frameTimer->isActive())
+    m_frameTimer->start();
+}
+
+void SmoothScroller::stop() {
+  m_frameTimer->stop();
+  m_position = m_scrollBar->value();
+  m_target = m_position;
+  m_velocity = 0.0;
+}
+
+bool SmoothScroller::isScrolling() const { return m_frameTimer->isActive(); }
+
+double SmoothScroller::velocity() const {
+  return isScrolling() ? m_velocity : 0.0;
+}
+
+void SmoothScroller::onFrame() {
+  double seconds = m_clock.nsecsElapsed() / 1e9;
+  m_clock.restart();
+  if (seconds <= 0.0)
+    return;
+
+  double previous = m_position;
+  double remaining = (m_position - m_target) * qExp(-seconds / EaseSeconds);
+  m_position = m_target + remaining;
+  if (qAbs(m_target - m_position) < 0.5)
+    m_position = m_target;
+  m_velocity = (m_position - previous) / seconds;
+
+  m_updating = true;
+  m_scrollBar->setValue(qRound(m_position));
+  m_updating = false;
+
+  if (m_position == m_target)
+    stop();
+}
+
+void SmoothScroller::onValueChanged() {
+  // A jump, a drag or a reload took over
+  if (!m_updating && isScrolling())
+    stop();
+}
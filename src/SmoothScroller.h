@@ -0,0 +1,45 @@
+#ifndef SMOOTHSCROLLER_H_
+#define SMOOTHSCROLLER_H_
+
+#include <QElapsedTimer>
+#include <QObject>
+
+class QScrollBar;
+class QTimer;
+
+// Animates a scroll bar toward a target that moves on as steps are added,
+// so a held key scrolls at a steady speed and a counted move glides to a
+// stop. Frames advance by the time that actually passed, so a late frame
+// catches up instead of slowing the scroll down. Moving the scroll bar any
+// other way ends the animation.
+class SmoothScroller : public QObject {
+  Q_OBJECT
+
+public:
+  explicit SmoothScroller(QScrollBar *scrollBar, QObject *parent = nullptr);
+
+  // Disabled, steps jump straight to their target
+  void setEnabled(bool enabled);
+  bool isEnabled() const;
+
+  void scrollBy(int pixels);
+  void stop();
+  bool isScrolling() const;
+  // Pixels per second, positive downwards; zero when not animating
+  double velocity() const;
+
+private:
+  void onFrame();
+  void onValueChanged();
+
+  QScrollBar *m_scrollBar;
+  QTimer *m_frameTimer;
+  QElapsedTimer m_clock;
+  bool m_enabled;
+  bool m_updating;
+  double m_position;
+  double m_target;
+  double m_velocity;
+};
+
+#endif // SMOOTHSCROLLER_H_
@@ -0,0 +1,55 @@
+#include "SystemMemory.h"
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <unistd.h>
+
+namespace {
+
+// Reads one "Name:  value kB" line of /proc/meminfo
+qint64 meminfoKB(const QByteArray &name) {
+  QFile meminfo("/proc/meminfo");
+  if (!meminfo.open(QIODevice::ReadOnly))
+    return -1;
+
+  const QList<QByteArray> lines = meminfo.readAll().split('\n');
+  for (const QByteArray &line : lines) {
+    if (!line.startsWith(name + ':'))
+      continue;
+
+    QList<QByteArray> fields =
+        line.mid(name.size() + 1).simplified().split(' ');
+    bool ok;
+    qint64 value = fields[0].toLongLong(&ok);
+    return ok ? value : -1;
+  }
+  return -1;
+}
+
+} // namespace
+
+namespace SystemMemory {
+
+qint64 residentKB() {
+  QFile statm("/proc/self/statm");
+  if (!statm.open(QIODevice::ReadOnly))
+    return -1;
+
+  // Fields are in pages: size resident shared text lib data dt
+  QList<QByteArray> fields = statm.readAll().split(' ');
+  if (fields.size() < 2)
+    return -1;
+
+  bool ok;
+  qint64 residentPages = fields[1].toLongLong(&ok);
+  if (!ok)
+    return -1;
+
+  return residentPages * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+qint64 availableKB() { return meminfoKB("MemAvailable"); }
+
+qint64 totalKB() { return meminfoKB("MemTotal"); }
+
+} // namespace SystemMemory
@@ -0,0 +1,18 @@
+#ifndef SYSTEMMEMORY_H_
+#define SYSTEMMEMORY_H_
+
+#include <QtGlobal>
+
+namespace SystemMemory {
+
+// Current resident set size of this process, or -1 when unavailable
+qint64 residentKB();
+
+// Memory the kernel can hand out without swapping, and installed memory;
+// -1 when unavailable
+qint64 availableKB();
+qint64 totalKB();
+
+} // namespace SystemMemory
+
+#endif // SYSTEMMEMORY_H_
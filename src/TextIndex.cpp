@@ -0,0 +1,246 @@
+#include "TextIndex.h"
+#include "Trace.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+#include <memory>
+#include <poppler/qt6/poppler-qt6.h>
+
+TextIndex::TextIndex(QObject *parent)
+    : QObject(parent), m_loadMode(Document::ReadFile), m_pageCount(0),
+      m_nextPage(0), m_stopping(0), m_paused(false), m_indexedPages(0),
+      m_failed(false) {}
+
+TextIndex::~TextIndex() { stop(); }
+
+void TextIndex::setDocument(const QString &filePath, Document::LoadMode mode,
+                            int pageCount) {
+  stop();
+
+  {
+    QMutexLocker locker(&m_mutex);
+    m_tokenIds.clear();
+    m_tokens.clear();
+    m_postings.clear();
+    m_pageWords.clear();
+    m_pageWords.resize(pageCount);
+    m_indexedPages = 0;
+    m_failed = false;
+  }
+
+  m_filePath = filePath;
+  m_loadMode = mode;
+  m_pageCount = pageCount;
+  m_nextPage.storeRelease(0);
+  m_stopping.storeRelease(0);
+
+  // A couple of threads keep indexing from competing with the page renderer
+  int threads = qMin(IndexThreads, qMax(1, pageCount));
+  for (int i = 0; i < threads; i++) {
+    QThread *worker = QThread::create([this]() { indexLoop(); });
+    worker->start();
+    m_workers.append(worker);
+  }
+}
+
+void TextIndex::setPaused(bool paused) {
+  QMutexLocker locker(&m_mutex);
+  m_paused = paused;
+  m_resumed.wakeAll();
+}
+
+void TextIndex::stop() {
+  m_stopping.storeRelease(1);
+  {
+    QMutexLocker locker(&m_mutex);
+    m_resumed.wakeAll();
+  }
+
+  for (QThread *worker : m_workers) {
+    worker->wait();
+    delete worker;
+  }
+  m_workers.clear();
+}
+
+void TextIndex::indexLoop() {
+  std::unique_ptr<Document> document;
+
+  while (!m_stopping.loadAcquire()) {
+    bool paused;
+    {
+      QMutexLocker locker(&m_mutex);
+      paused = m_paused;
+    }
+
+    if (paused) {
+      document.reset();
+
+      QMutexLocker locker(&m_mutex);
+      while (m_paused && !m_stopping.loadAcquire())
+        m_resumed.wait(&m_mutex);
+      continue;
+    }
+
+    if (!document) {
+      document = std::make_unique<Document>();
+      if (!document->load(m_filePath, m_loadMode)) {
+        // Searches stop waiting for pages that will never be indexed
+        int indexed;
+        {
+          QMutexLocker locker(&m_mutex);
+          m_failed = true;
+          indexed = m_indexedPages;
+        }
+        emit progress(indexed, m_pageCount);
+        return;
+      }
+    }
+
+    int pageNumber = m_nextPage.fetchAndAddOrdered(1);
+    if (pageNumber >= m_pageCount)
+      break;
+
+    TraceSpan span("index", pageNumber);
+
+    QStringList words;
+    QVector<QRectF> boxes;
+
+    auto page = document->popplerDocument()->page(pageNumber);
+    if (page) {
+      for (const auto &box : page->textList()) {
+        // A box is roughly one word; punctuation around it is dropped so
+        // "word," and "word" share a token
+        for (const QString &token : tokenize(box->text())) {
+          words.append(token);
+          boxes.append(box->boundingBox());
+        }
+      }
+    }
+
+    addPage(pageNumber, words, boxes);
+  }
+}
+
+void TextIndex::addPage(int pageNumber, const QStringList &words,
+                        const QVector<QRectF> &boxes) {
+  int indexed;
+
+  {
+    QMutexLocker locker(&m_mutex);
+    QVector<Word> &pageWords = m_pageWords[pageNumber];
+    pageWords.reserve(words.size());
+
+    for (int i = 0; i < words.size(); i++) {
+      auto it = m_tokenIds.constFind(words[i]);
+      int token;
+      if (it != m_tokenIds.constEnd()) {
+        token = it.value();
+      } else {
+        token = m_tokens.size();
+        m_tokenIds.insert(words[i], token);
+        m_tokens.append(words[i]);
+        m_postings.append(QVector<Posting>());
+      }
+
+      m_postings[token].append({pageNumber, int(pageWords.size())});
+      pageWords.append({token, boxes[i]});
+    }
+
+    indexed = ++m_indexedPages;
+  }
+
+  emit progress(indexed, m_pageCount);
+}
+
+QStringList TextIndex::tokenize(const QString &text) {
+  QStringList tokens;
+
+  for (const QString &part : text.split(' ', Qt::SkipEmptyParts)) {
+    int begin = 0;
+    int end = part.size();
+    while (begin < end && !part[begin].isLetterOrNumber())
+      begin++;
+    while (end > begin && !part[end - 1].isLetterOrNumber())
+      end--;
+
+    if (begin < end)
+      tokens.append(part.mid(begin, end - begin).toLower());
+  }
+
+  return tokens;
+}
+
+QVector<TextIndex::Hit> TextIndex::search(const QString &pattern) const {
+  QVector<Hit> hits;
+
+  QStringList terms = tokenize(pattern.simplified());
+  if (terms.isEmpty())
+    return hits;
+
+  QMutexLocker locker(&m_mutex);
+
+  auto matches = [&](int token, int term) {
+    const QString &word = m_tokens[token];
+    return term == terms.size() - 1 ? word.startsWith(terms[term])
+                                    : word == terms[term];
+  };
+
+  // Starting tokens: a prefix scan of the token table for a single word,
+  // a hash lookup otherwise
+  QVector<int> starts;
+  if (terms.size() == 1) {
+    for (int token = 0; token < m_tokens.size(); token++) {
+      if (matches(token, 0))
+        starts.append(token);
+    }
+  } else {
+    auto it = m_tokenIds.constFind(terms.first());
+    if (it != m_tokenIds.constEnd())
+      starts.append(it.value());
+  }
+
+  for (int start : starts) {
+    for (const Posting &posting : m_postings[start]) {
+      const QVector<Word> &pageWords = m_pageWords[posting.pageNumber];
+      if (posting.word + terms.size() > pageWords.size())
+        continue;
+
+      QRectF rect = pageWords[posting.word].box;
+      bool found = true;
+
+      for (int term = 1; term < terms.size() && found; term++) {
+        const Word &word = pageWords[posting.word + term];
+        found = matches(word.token, term);
+        rect = rect.united(word.box);
+      }
+
+      if (found)
+        hits.append({posting.pageNumber, rect});
+    }
+  }
+
+  std::sort(hits.begin(), hits.end(), [](const Hit &a, const Hit &b) {
+    if (a.pageNumber != b.pageNumber)
+      return a.pageNumber < b.pageNumber;
+    if (a.rect.top() != b.rect.top())
+      return a.rect.top() < b.rect.top();
+    return a.rect.left() < b.rect.left();
+  });
+
+  return hits;
+}
+
+int TextIndex::indexedPages() const {
+  QMutexLocker locker(&m_mutex);
+  return m_indexedPages;
+}
+
+int TextIndex::pageCount() const { return m_pageCount; }
+
+bool TextIndex::isComplete() const { return indexedPages() >= m_pageCount; }
+
+bool TextIndex::hasFailed() const {
+  QMutexLocker locker(&m_mutex);
+  return m_failed;
+}
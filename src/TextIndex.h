@@ -0,0 +1,94 @@
+#ifndef TEXTINDEX_H_
+#define TEXTINDEX_H_
+
+#include "Document.h"
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QRectF>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+class QThread;
+
+// In-memory word index of a document's text, built by background threads
+// that each open their own Document. Every page keeps its words in reading
+// order as token ids with boxes, and every token keeps the places it occurs,
+// so searches never touch Poppler. Searching while the index is being built
+// returns hits from the pages indexed so far.
+class TextIndex : public QObject {
+  Q_OBJECT
+
+public:
+  static constexpr int IndexThreads = 2;
+
+  // rect is in page points
+  struct Hit {
+    int pageNumber;
+    QRectF rect;
+  };
+
+  explicit TextIndex(QObject *parent = nullptr);
+  ~TextIndex();
+
+  void setDocument(const QString &filePath, Document::LoadMode mode,
+                   int pageCount);
+  // Paused indexing holds no document open and picks up where it stopped
+  void setPaused(bool paused);
+
+  // Case-insensitive phrase search. The last word also matches as a prefix,
+  // so "/spec" finds "specification". Hits are in page order.
+  QVector<Hit> search(const QString &pattern) const;
+
+  int indexedPages() const;
+  int pageCount() const;
+  bool isComplete() const;
+  // The document could not be opened; no more pages will be indexed
+  bool hasFailed() const;
+
+signals:
+  // Emitted from the indexing threads, connect with a queued connection
+  void progress(int indexed, int total);
+
+private:
+  struct Word {
+    int token;
+    QRectF box;
+  };
+
+  struct Posting {
+    int pageNumber;
+    int word;
+  };
+
+  static QStringList tokenize(const QString &text);
+
+  void stop();
+  void indexLoop();
+  void addPage(int pageNumber, const QStringList &words,
+               const QVector<QRectF> &boxes);
+
+  QString m_filePath;
+  Document::LoadMode m_loadMode;
+  int m_pageCount;
+
+  QList<QThread *> m_workers;
+  QAtomicInt m_nextPage;
+  QAtomicInt m_stopping;
+
+  mutable QMutex m_mutex;
+  QWaitCondition m_resumed;
+  bool m_paused;
+  QHash<QString, int> m_tokenIds;
+  QVector<QString> m_tokens;
+  QVector<QVector<Posting>> m_postings;
+  QVector<QVector<Word>> m_pageWords;
+  int m_indexedPages;
+  bool m_failed;
+};
+
+#endif // TEXTINDEX_H_
@@ -0,0 +1,320 @@
+#include "ThumbnailPanel.h"
+#include "Trace.h"
+#include <QMetaObject>
+#include <QMouseEvent>
+#include <QMutexLocker>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QThread>
+#include <poppler/qt6/poppler-qt6.h>
+
+namespace {
+
+// Cell padding and the page number line under each thumbnail
+const int Padding = 10;
+const int LabelHeight = 18;
+
+// About 130 thumbnails, a few screens of cells
+const int CacheKB = 8 * 1024;
+
+} // namespace
+
+ThumbnailPanel::ThumbnailPanel(QWidget *parent)
+    : QAbstractScrollArea(parent), m_document(nullptr), m_currentPage(-1),
+      m_thumbnails(CacheKB), m_worker(nullptr), m_loadMode(Document::ReadFile),
+      m_documentRevision(0), m_stopping(false), m_generation(0) {
+  setStyleSheet("background-color: #111111; border: none;");
+  setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+  setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+  setFixedWidth(ThumbnailWidth + 2 * Padding +
+                verticalScrollBar()->sizeHint().width());
+  setFocusPolicy(Qt::NoFocus);
+
+  m_worker = QThread::create([this]() { workerLoop(); });
+  m_worker->start();
+}
+
+ThumbnailPanel::~ThumbnailPanel() {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_stopping = true;
+    m_queue.clear();
+  }
+  m_jobAvailable.wakeAll();
+
+  m_worker->wait();
+  delete m_worker;
+}
+
+void ThumbnailPanel::setDocument(const Document *document) {
+  m_document = document;
+  m_currentPage = -1;
+  m_thumbnails.clear();
+
+  {
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    m_filePath = document ? document->filePath() : QString();
+    m_loadMode = document ? document->loadMode() : Document::ReadFile;
+    m_documentRevision++;
+    m_generation.fetchAndAddOrdered(1);
+  }
+
+  updateScrollBars();
+  verticalScrollBar()->setValue(0);
+  requestVisible();
+  viewport()->update();
+}
+
+void ThumbnailPanel::reloadDocument() {
+  // The worker opens the file again before its next job
+  {
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    m_documentRevision++;
+    m_generation.fetchAndAddOrdered(1);
+  }
+
+  updateScrollBars();
+  requestVisible();
+  viewport()->update();
+}
+
+void ThumbnailPanel::invalidatePages(const QList<int> &pageNumbers) {
+  for (int page : pageNumbers)
+    m_thumbnails.remove(page);
+
+  requestVisible();
+  viewport()->update();
+}
+
+void ThumbnailPanel::setCurrentPage(int pageNumber) {
+  if (pageNumber == m_currentPage)
+    return;
+
+  QRect oldCell = cellRect(m_currentPage);
+  m_currentPage = pageNumber;
+
+  // Keep the current page's cell in view as the main view moves
+  QRect cell = cellRect(pageNumber);
+  int top = verticalScrollBar()->value();
+  if (cell.top() < top)
+    verticalScrollBar()->setValue(cell.top());
+  else if (cell.bottom() > top + viewport()->height())
+    verticalScrollBar()->setValue(cell.bottom() - viewport()->height() + 1);
+
+  viewport()->update(oldCell.translated(0, -verticalScrollBar()->value()));
+  viewport()->update(cell.translated(0, -verticalScrollBar()->value()));
+}
+
+qint64 ThumbnailPanel::cachedBytes() const {
+  return qint64(m_thumbnails.totalCost()) * 1024;
+}
+
+int ThumbnailPanel::cellHeight() const {
+  return ThumbnailHeight + LabelHeight + 2 * Padding;
+}
+
+int ThumbnailPanel::pageCount() const {
+  return m_document ? m_document->pageCount() : 0;
+}
+
+QRect ThumbnailPanel::cellRect(int pageNumber) const {
+  if (pageNumber < 0)
+    return QRect();
+  return QRect(0, pageNumber * cellHeight(), viewport()->width(),
+               cellHeight());
+}
+
+void ThumbnailPanel::updateScrollBars() {
+  int height = pageCount() * cellHeight();
+
+  verticalScrollBar()->setPageStep(viewport()->height());
+  verticalScrollBar()->setSingleStep(cellHeight() / 2);
+  verticalScrollBar()->setRange(0,
+                                qMax(0, height - viewport()->height()));
+}
+
+void ThumbnailPanel::requestVisible() {
+  if (!isVisible() || pageCount() == 0)
+    return;
+
+  int top = verticalScrollBar()->value();
+  int first = qMax(0, top / cellHeight() - 1);
+  int last = qMin(pageCount() - 1,
+                  (top + viewport()->height()) / cellHeight() + 1);
+
+  // Cells that scrolled away are not worth loading any more. The one in
+  // flight still lands in the cache.
+  {
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+
+    for (int i = first; i <= last; i++) {
+      if (!m_thumbnails.contains(i))
+        m_queue.enqueue({i, m_generation.loadAcquire()});
+    }
+  }
+  m_jobAvailable.wakeOne();
+}
+
+void ThumbnailPanel::workerLoop() {
+  Document document;
+  quint64 loadedRevision = 0;
+
+  while (true) {
+    Job job;
+    QString filePath;
+    Document::LoadMode loadMode;
+    quint64 revision;
+
+    {
+      QMutexLocker locker(&m_mutex);
+      while (m_queue.isEmpty() && !m_stopping)
+        m_jobAvailable.wait(&m_mutex);
+
+      if (m_stopping)
+        return;
+
+      job = m_queue.dequeue();
+      filePath = m_filePath;
+      loadMode = m_loadMode;
+      revision = m_documentRevision;
+    }
+
+    if (job.generation != m_generation.loadAcquire())
+      continue;
+
+    if (revision != loadedRevision) {
+      document.load(filePath, loadMode);
+      loadedRevision = revision;
+    }
+
+    QImage image = loadThumbnail(document, job.pageNumber);
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, job, image]() {
+          onThumbnailLoaded(job.pageNumber, job.generation, image);
+        },
+        Qt::QueuedConnection);
+  }
+}
+
+QImage ThumbnailPanel::loadThumbnail(const Document &document,
+                                     int pageNumber) const {
+  TraceSpan span("thumbnail", pageNumber);
+
+  if (!document.isLoaded())
+    return QImage();
+
+  QSize box(ThumbnailWidth, ThumbnailHeight);
+
+  // Embedded thumbnails cost a decode instead of a render
+  auto page = document.popplerDocument()->page(pageNumber);
+  QImage image = page ? page->thumbnail() : QImage();
+
+  if (image.isNull()) {
+    QSizeF sizePoints = document.pageSize(pageNumber);
+    if (sizePoints.isEmpty())
+      return QImage();
+
+    double dpi = 72.0 * qMin(box.width() / sizePoints.width(),
+                             box.height() / sizePoints.height());
+    image = document.renderPage(pageNumber, dpi);
+  }
+
+  if (image.width() > box.width() || image.height() > box.height())
+    image = image.scaled(box, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+  return image.convertToFormat(QImage::Format_RGB32);
+}
+
+void ThumbnailPanel::onThumbnailLoaded(int pageNumber, quint64 generation,
+                                       const QImage &image) {
+  // Stale results belong to a previous document
+  if (generation != m_generation.loadAcquire() || image.isNull())
+    return;
+
+  m_thumbnails.insert(pageNumber, new QImage(image),
+                      qMax<qsizetype>(1, image.sizeInBytes() / 1024));
+
+  viewport()->update(
+      cellRect(pageNumber).translated(0, -verticalScrollBar()->value()));
+}
+
+void ThumbnailPanel::paintEvent(QPaintEvent *event) {
+  QPainter painter(viewport());
+  painter.fillRect(event->rect(), QColor(17, 17, 17));
+
+  if (pageCount() == 0)
+    return;
+
+  int top = verticalScrollBar()->value();
+  QRect exposed = event->rect().translated(0, top);
+  int first = qMax(0, exposed.top() / cellHeight());
+  int last = qMin(pageCount() - 1, exposed.bottom() / cellHeight());
+
+  for (int i = first; i <= last; i++) {
+    QRect cell = cellRect(i).translated(0, -top);
+
+    if (i == m_currentPage)
+      painter.fillRect(cell.adjusted(2, 2, -2, -2), QColor(60, 60, 90));
+
+    QRect box(cell.left() + (cell.width() - ThumbnailWidth) / 2,
+              cell.top() + Padding, ThumbnailWidth, ThumbnailHeight);
+
+    QImage *thumbnail = m_thumbnails.object(i);
+    if (thumbnail) {
+      QRect target(QPoint(0, 0), thumbnail->size());
+      target.moveCenter(box.center());
+      painter.drawImage(target.topLeft(), *thumbnail);
+    } else {
+      // Placeholder with the page's aspect ratio until the image arrives
+      QSizeF sizePoints = m_document->pageSize(i);
+      QSize size = sizePoints.isEmpty()
+                       ? box.size()
+                       : sizePoints.scaled(box.size(), Qt::KeepAspectRatio)
+                             .toSize();
+      QRect target(QPoint(0, 0), size);
+      target.moveCenter(box.center());
+      painter.fillRect(target, QColor(40, 40, 40));
+    }
+
+    painter.setPen(i == m_currentPage ? Qt::white : QColor(150, 150, 150));
+    painter.drawText(QRect(cell.left(), box.bottom() + 2, cell.width(),
+                           LabelHeight),
+                     Qt::AlignCenter, QString::number(i + 1));
+  }
+}
+
+void ThumbnailPanel::resizeEvent(QResizeEvent *event) {
+  QAbstractScrollArea::resizeEvent(event);
+  updateScrollBars();
+  requestVisible();
+}
+
+void ThumbnailPanel::scrollContentsBy(int dx, int dy) {
+  Q_UNUSED(dx);
+  Q_UNUSED(dy);
+
+  viewport()->update();
+  requestVisible();
+}
+
+void ThumbnailPanel::mousePressEvent(QMouseEvent *event) {
+  if (pageCount() == 0)
+    return;
+
+  int y = event->position().toPoint().y() + verticalScrollBar()->value();
+  int page = y / cellHeight();
+  if (page >= 0 && page < pageCount())
+    emit pageActivated(page);
+}
+
+void ThumbnailPanel::showEvent(QShowEvent *event) {
+  QAbstractScrollArea::showEvent(event);
+  updateScrollBars();
+  requestVisible();
+}
@@ -0,0 +1,84 @@
+#ifndef THUMBNAILPANEL_H_
+#define THUMBNAILPANEL_H_
+
+#include "Document.h"
+#include <QAbstractScrollArea>
+#include <QAtomicInteger>
+#include <QCache>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QWaitCondition>
+
+class QThread;
+
+// Side panel with one fixed-size cell per page. Only the cells in view are
+// painted and requested. A dedicated thread with its own Document fills
+// them from the PDF's embedded thumbnails where present and from very
+// low-DPI renders otherwise. Thumbnails live in their own byte-bounded
+// cache, apart from the full-size rasters.
+class ThumbnailPanel : public QAbstractScrollArea {
+  Q_OBJECT
+
+public:
+  static const int ThumbnailWidth = 120;
+  static const int ThumbnailHeight = 170;
+
+  explicit ThumbnailPanel(QWidget *parent = nullptr);
+  ~ThumbnailPanel();
+
+  void setDocument(const Document *document);
+  void setCurrentPage(int pageNumber);
+  // Picks up the rewritten file while keeping cached thumbnails; the pages
+  // that changed are dropped afterwards with invalidatePages()
+  void reloadDocument();
+  void invalidatePages(const QList<int> &pageNumbers);
+
+  qint64 cachedBytes() const;
+
+signals:
+  void pageActivated(int pageNumber);
+
+protected:
+  void paintEvent(QPaintEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+  void scrollContentsBy(int dx, int dy) override;
+  void mousePressEvent(QMouseEvent *event) override;
+  void showEvent(QShowEvent *event) override;
+
+private:
+  struct Job {
+    int pageNumber;
+    quint64 generation;
+  };
+
+  int cellHeight() const;
+  int pageCount() const;
+  QRect cellRect(int pageNumber) const;
+  void updateScrollBars();
+  void requestVisible();
+  void workerLoop();
+  QImage loadThumbnail(const Document &document, int pageNumber) const;
+  void onThumbnailLoaded(int pageNumber, quint64 generation,
+                         const QImage &image);
+
+  const Document *m_document;
+  int m_currentPage;
+
+  QCache<int, QImage> m_thumbnails;
+
+  QThread *m_worker;
+  QMutex m_mutex;
+  QWaitCondition m_jobAvailable;
+  QQueue<Job> m_queue;
+  QString m_filePath;
+  Document::LoadMode m_loadMode;
+  quint64 m_documentRevision;
+  bool m_stopping;
+
+  QAtomicInteger<quint64> m_generation;
+};
+
+#endif // THUMBNAILPANEL_H_
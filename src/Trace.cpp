@@ -0,0 +1,140 @@
+#include "Trace.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+namespace {
+
+struct Event {
+  const char *name;
+  qint64 startNs;
+  qint64 durationNs;
+  int threadId;
+  int pageNumber;
+  double dpi;
+};
+
+// Keeps a forgotten trace from growing without bound, at roughly 40 MB
+const int MaxEvents = 1000000;
+
+QAtomicInt enabled(0);
+QAtomicInt nextThreadId(1);
+QMutex mutex;
+QVector<Event> events;
+QString path;
+
+qint64 nowNs() {
+  static QElapsedTimer clock = []() {
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+  }();
+  return clock.nsecsElapsed();
+}
+
+int currentThreadId() {
+  thread_local int id = nextThreadId.fetchAndAddRelaxed(1);
+  return id;
+}
+
+// Spans that straddle a stop are dropped rather than written late
+void record(const Event &event) {
+  QMutexLocker locker(&mutex);
+  if (enabled.loadAcquire() && events.size() < MaxEvents)
+    events.append(event);
+}
+
+} // namespace
+
+namespace Trace {
+
+bool start(const QString &outputPath) {
+  if (outputPath.isEmpty())
+    return false;
+
+  QMutexLocker locker(&mutex);
+  events.clear();
+  path = outputPath;
+  enabled.storeRelease(1);
+  return true;
+}
+
+int stop(QString *error) {
+  QVector<Event> recorded;
+  QString outputPath;
+
+  {
+    QMutexLocker locker(&mutex);
+    if (!enabled.loadAcquire())
+      return 0;
+
+    enabled.storeRelease(0);
+    recorded.swap(events);
+    outputPath = path;
+  }
+
+  QFile file(outputPath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    if (error)
+      *error = file.errorString();
+    return -1;
+  }
+
+  // Complete ("X") events with microsecond timestamps
+  file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (int i = 0; i < recorded.size(); i++) {
+    const Event &event = recorded[i];
+
+    QByteArray line = QByteArray("{\"name\":\"") + event.name +
+                      "\",\"cat\":\"ctrlp\",\"ph\":\"X\",\"pid\":1,\"tid\":" +
+                      QByteArray::number(event.threadId) + ",\"ts\":" +
+                      QByteArray::number(event.startNs / 1000.0, 'f', 3) +
+                      ",\"dur\":" +
+                      QByteArray::number(event.durationNs / 1000.0, 'f', 3) +
+                      ",\"args\":{";
+    if (event.pageNumber >= 0) {
+      line += "\"page\":" + QByteArray::number(event.pageNumber + 1);
+      if (event.dpi > 0)
+        line += ",\"dpi\":" + QByteArray::number(event.dpi, 'f', 1);
+    }
+    line += "}}";
+    if (i < recorded.size() - 1)
+      line += ',';
+    line += '\n';
+
+    file.write(line);
+  }
+  file.write("]}\n");
+
+  if (file.error() != QFileDevice::NoError) {
+    if (error)
+      *error = file.errorString();
+    return -1;
+  }
+
+  return recorded.size();
+}
+
+bool isEnabled() { return enabled.loadAcquire(); }
+
+QString outputPath() {
+  QMutexLocker locker(&mutex);
+  return path;
+}
+
+} // namespace Trace
+
+TraceSpan::TraceSpan(const char *name, int pageNumber, double dpi)
+    : m_name(name), m_pageNumber(pageNumber), m_dpi(dpi),
+      m_startNs(Trace::isEnabled() ? nowNs() : -1) {}
+
+TraceSpan::~TraceSpan() {
+  if (m_startNs < 0)
+    return;
+
+  record({m_name, m_startNs, nowNs() - m_startNs, currentThreadId(),
+          m_pageNumber, m_dpi});
+}
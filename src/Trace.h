@@ -0,0 +1,36 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <QString>
+#include <QtGlobal>
+
+// Optional span recording for the load, render, convert, upload and paint
+// phases. Spans are kept in memory while tracing is on and written as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev) when it stops.
+namespace Trace {
+
+bool start(const QString &path);
+// Writes the trace and returns the number of spans written, or -1 on error
+int stop(QString *error = nullptr);
+bool isEnabled();
+QString outputPath();
+
+} // namespace Trace
+
+// Times the enclosing scope. Costs one atomic load when tracing is off.
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name, int pageNumber = -1, double dpi = 0.0);
+  ~TraceSpan();
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *m_name;
+  int m_pageNumber;
+  double m_dpi;
+  qint64 m_startNs; // -1 when tracing was off at construction
+};
+
+#endif // TRACE_H_
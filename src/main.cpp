@@ -1,21 +1,184 @@
+#include "BatchExporter.h"
 #include "MainWindow.h"
+#include "Trace.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QMessageBox>
 #include <QStringList>
+#include <climits>
 #include <iostream>
+#include <memory>
+
+namespace {
+
+// Reads an integer option of at least minimum, or complains and fails
+bool intOption(const QCommandLineParser &parser, const QString &name,
+               int minimum, int *value) {
+  bool ok;
+  int parsed = parser.value(name).toInt(&ok);
+  if (!ok || parsed < minimum) {
+    std::cerr << "Invalid --" << qPrintable(name) << ": "
+              << qPrintable(parser.value(name)) << '\n';
+    return false;
+  }
+  *value = parsed;
+  return true;
+}
+
+void addOptions(QCommandLineParser *parser) {
+  parser->setApplicationDescription("Keyboard-driven PDF print preview");
+  parser->addHelpOption();
+  parser->addOption({"mmap",
+                     "Memory-map the PDF instead of reading it. Mapped files "
+                     "are not watched for rewrites."});
+  parser->addOption({"export",
+                     "Render the page range of every file to images in "
+                     "<dir> without opening a window.",
+                     "dir"});
+  parser->addOption({"dpi", "Export resolution.", "dpi", "150"});
+  parser->addOption({"format", "Export image format.", "format", "png"});
+  parser->addOption({"gray", "Export in grayscale."});
+  parser->addOption({"margins",
+                     "Margin preset: none, minimal, normal, comfortable or "
+                     "wide.",
+                     "preset"});
+  parser->addOption({"layout", "Page layout: 1up, 2up, 4up or booklet.",
+                     "layout"});
+  parser->addOption({"from", "First page to export.", "page"});
+  parser->addOption({"to", "Last page to export.", "page"});
+  parser->addOption({"jobs", "Worker threads, one per core by default.",
+                     "count", "0"});
+  parser->addOption({"disk-cache",
+                     "Keep rendered pages in <dir> across sessions.", "dir"});
+  parser->addOption({"disk-cache-mb", "Size cap of the disk cache.", "mb",
+                     "1024"});
+  parser->addPositionalArgument("files", "PDFs to open or export.");
+}
+
+int runExport(const QCommandLineParser &parser, const QStringList &files) {
+  BatchExporter::Options options;
+  options.outputDir = parser.value("export");
+  options.format = parser.value("format");
+  if (!intOption(parser, "jobs", 0, &options.threads))
+    return 1;
+
+  if (parser.isSet("mmap") || qEnvironmentVariableIntValue("CTRLP_MMAP"))
+    options.loadMode = Document::MemoryMap;
+
+  bool ok;
+  double dpi = parser.value("dpi").toDouble(&ok);
+  if (!ok || dpi <= 0) {
+    std::cerr << "Invalid DPI: " << qPrintable(parser.value("dpi")) << '\n';
+    return 1;
+  }
+  options.dpi = dpi;
+
+  PrintSettings &settings = options.settings;
+  settings.colorMode = !parser.isSet("gray");
+
+  if (parser.isSet("margins") &&
+      !PrintSettings::marginPresetFromName(parser.value("margins"),
+                                           &settings.margins)) {
+    std::cerr << "Unknown margin preset: "
+              << qPrintable(parser.value("margins")) << '\n';
+    return 1;
+  }
+
+  if (parser.isSet("layout") &&
+      !PrintSettings::pageLayoutFromName(parser.value("layout"),
+                                         &settings.pageLayout)) {
+    std::cerr << "Unknown page layout: " << qPrintable(parser.value("layout"))
+              << '\n';
+    return 1;
+  }
+
+  if (parser.isSet("from") || parser.isSet("to")) {
+    settings.printAllPages = false;
+    settings.fromPage = 1;
+    settings.toPage = INT_MAX;
+    if (parser.isSet("from") &&
+        !intOption(parser, "from", 1, &settings.fromPage))
+      return 1;
+    if (parser.isSet("to") && !intOption(parser, "to", 1, &settings.toPage))
+      return 1;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  BatchExporter exporter(options);
+  bool success = exporter.run(files);
+
+  double seconds = timer.nsecsElapsed() / 1e9;
+
+  for (const QString &error : exporter.errors())
+    std::cerr << qPrintable(error) << '\n';
+
+  std::cout << exporter.pagesWritten() << " pages in " << seconds << " s ("
+            << (seconds > 0 ? exporter.pagesWritten() / seconds : 0.0)
+            << " pages/s)\n";
+
+  return success ? 0 : 1;
+}
+
+} // namespace
 
 int main(int argc, char *argv[]) {
-  QApplication app(argc, argv);
+  QCommandLineParser parser;
+  addOptions(&parser);
+
+  // Export runs without a display, so it must not create a QApplication.
+  // The parser reads argv before there is one; errors and --help are
+  // reported by process() below.
+  QStringList arguments;
+  for (int i = 0; i < argc; i++)
+    arguments.append(QString::fromLocal8Bit(argv[i]));
+  parser.parse(arguments);
+  bool headless = parser.isSet("export");
+
+  std::unique_ptr<QCoreApplication> app;
+  if (headless)
+    app = std::make_unique<QCoreApplication>(argc, argv);
+  else
+    app = std::make_unique<QApplication>(argc, argv);
 
-  QStringList args = app.arguments();
+  parser.process(*app);
 
-  QString filePath;
-  if (args.size() > 1)
-    filePath = args.at(1);
+  QStringList args = parser.positionalArguments();
+
+  // CTRLP_TRACE=file records a Chrome trace of the whole run
+  if (!qEnvironmentVariableIsEmpty("CTRLP_TRACE"))
+    Trace::start(qEnvironmentVariable("CTRLP_TRACE"));
+
+  if (headless) {
+    if (args.isEmpty()) {
+      std::cerr << "No input files\n";
+      return 1;
+    }
+    int exitCode = runExport(parser, args);
+    Trace::stop();
+    return exitCode;
+  }
 
   MainWindow window;
 
-  if (!filePath.isEmpty()) {
+  if (parser.isSet("mmap") || qEnvironmentVariableIntValue("CTRLP_MMAP"))
+    window.setLoadMode(Document::MemoryMap);
+
+  QString diskCache = parser.isSet("disk-cache")
+                          ? parser.value("disk-cache")
+                          : qEnvironmentVariable("CTRLP_DISK_CACHE");
+  if (!diskCache.isEmpty()) {
+    int megabytes;
+    if (!intOption(parser, "disk-cache-mb", 1, &megabytes))
+      return 1;
+    window.enableDiskCache(diskCache, qint64(megabytes) * 1024 * 1024);
+  }
+
+  // Every file opens in its own tab
+  for (const QString &filePath : args) {
     if (!window.loadDocument(filePath)) {
       QMessageBox::critical(nullptr, "Error", "Failed to load: " + filePath);
       return 1;
@@ -24,7 +187,8 @@ int main(int argc, char *argv[]) {
 
   window.show();
 
-  int exitCode = app.exec();
+  int exitCode = app->exec();
+  Trace::stop();
 
   if (exitCode != 0)
     std::cout << "Application exited with exit code " << exitCode << '\n';